@@ -1,6 +1,12 @@
 #include "eso2d.h"
+#include "debugger.h"
+#include "journal.h"
+#include "performance.h"
 #include "BearLibTerminal.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 
 void Put(int x, int y, int code)
@@ -23,6 +29,89 @@ uint32_t MakeColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 	return color_from_argb(a, r, g, b);
 }
 
+static void DrawHud(const Grid& grid, const PerformanceMeter& meter)
+{
+	const int hudWidth = 20;
+	const int hudHeight = 6;
+	char lines[hudHeight][hudWidth + 1];
+	std::snprintf(lines[0], sizeof(lines[0]), "steps/s %12.0f", meter.StepsPerSecond());
+	std::snprintf(lines[1], sizeof(lines[1]), "steps   %12llu", static_cast<unsigned long long>(grid.Counters().steps));
+	std::snprintf(lines[2], sizeof(lines[2]), "cursors %12zu", grid.Cursors().size());
+	std::snprintf(lines[3], sizeof(lines[3]), "frame   %9.1f ms", meter.FrameTime() * 1000.0);
+	std::snprintf(lines[4], sizeof(lines[4]), "update  %10.1f %%", meter.UpdateShare() * 100.0);
+	std::snprintf(lines[5], sizeof(lines[5]), "print   %10.1f %%", meter.PrintShare() * 100.0);
+
+	const int left = terminal_state(TK_WIDTH) - hudWidth;
+
+	// dim the grid under the hud so the text stays readable
+	terminal_layer(3);
+	terminal_color(0xCC000000);
+	for (int j = 0; j < hudHeight; j++)
+	{
+		for (int i = 0; i < hudWidth; i++)
+		{
+			terminal_put(left + i, j, 0x2588);
+		}
+	}
+
+	terminal_layer(4);
+	terminal_color(0xFF66FF66);
+	for (int j = 0; j < hudHeight; j++)
+	{
+		terminal_print(left, j, lines[j]);
+	}
+}
+
+static void DrawStop(const DebugStop& stop)
+{
+	char line[96];
+	switch (stop.kind)
+	{
+	case DebugStop::Breakpoint:
+		std::snprintf(line, sizeof(line), "breakpoint at (%d, %d)", stop.x, stop.y);
+		break;
+
+	case DebugStop::Watchpoint:
+		std::snprintf(line, sizeof(line), "watchpoint at (%d, %d) written", stop.x, stop.y);
+		break;
+
+	case DebugStop::CursorCount:
+		std::snprintf(line, sizeof(line), "%zu cursors alive", stop.cursors);
+		break;
+
+	case DebugStop::StepReached:
+		std::snprintf(line, sizeof(line), "reached step %llu", static_cast<unsigned long long>(stop.step + 1));
+		break;
+
+	default:
+		std::snprintf(line, sizeof(line), "paused");
+		break;
+	}
+
+	terminal_layer(4);
+	terminal_color(0xFFFFCC00);
+	terminal_print(0, terminal_state(TK_HEIGHT) - 1, line);
+	terminal_print(0, terminal_state(TK_HEIGHT) - 2, "space: continue  n: step  esc: stop");
+}
+
+// read a number on the bottom row. returns false if cancelled or empty.
+static bool Prompt(const char* label, unsigned long long& value)
+{
+	const int row = terminal_state(TK_HEIGHT) - 1;
+	const int column = static_cast<int>(std::strlen(label));
+	char buffer[24] = { };
+
+	terminal_layer(4);
+	terminal_color(0xFFFFCC00);
+	terminal_print(0, row, label);
+	terminal_refresh();
+	if (terminal_read_str(column, row, buffer, sizeof(buffer) - 1) <= 0) { return false; }
+
+	char* end = nullptr;
+	value = std::strtoull(buffer, &end, 10);
+	return end != buffer;
+}
+
 int main()
 {
 	terminal_open();
@@ -34,18 +123,26 @@ int main()
 	const int h = terminal_state(TK_HEIGHT);
 	Grid grid(w, h);
 
+	// the mapped autosave persists every edit as it happens.
+	// the text autosave and its edit journal are only read to migrate them, or if mapping fails.
+	Journal journal("autosave.e2d", "autosave.e2dj");
+	bool mapped = std::ifstream("autosave.e2dm") && grid.MapFile("autosave.e2dm");
+	if (!mapped)
 	{
-		std::ifstream in("autosave.e2d", std::ios_base::binary);
-		if (in)
-		{
-			in >> grid;
-		}
+		journal.Load(grid);
+		mapped = grid.MapFile("autosave.e2dm");
+		// once migrated the text autosave is stale. left behind, a later mapping failure would load it and undo every edit since
+		if (mapped) { journal.Discard(); }
 	}
 
+	// f9 toggles a breakpoint, f8 a watchpoint, f7 and f6 set conditions, f10 clears them all
+	Debugger debugger(grid.Width(), grid.Height());
+
 	int x = 0;
 	int y = 0;
 
 	grid.Print();
+	debugger.Print(grid);
 	terminal_color(0xFFFF0000);
 	terminal_layer(2);
 	terminal_put(x, y, '_');
@@ -79,6 +176,28 @@ int main()
 			{
 				if (++y >= grid.Height()) { y--; }
 			}
+			else if (code == TK_F9)
+			{
+				debugger.SetBreakpoint(x, y, !debugger.HasBreakpoint(x, y));
+			}
+			else if (code == TK_F8)
+			{
+				debugger.SetWatchpoint(x, y, !debugger.HasWatchpoint(x, y));
+			}
+			else if (code == TK_F7)
+			{
+				unsigned long long count;
+				if (Prompt("break when cursors > ", count)) { debugger.BreakWhenCursorsAbove(count); }
+			}
+			else if (code == TK_F6)
+			{
+				unsigned long long step;
+				if (Prompt("break at step ", step)) { debugger.BreakAtStep(step); }
+			}
+			else if (code == TK_F10)
+			{
+				debugger.Clear();
+			}
 			else if (code == TK_CLOSE)
 			{
 				loop = false;
@@ -87,40 +206,31 @@ int main()
 
 		if (terminal_state(TK_ENTER))
 		{
-			int ipStartX = -1;
-			int ipStartY = -1;
-			int selStartX = -1;
-			int selStartY = -1;
-			for (int i = 0; i < grid.Width(); i++)
+			if (grid.QueueStartCursor())
 			{
-				for (int j = 0; j < grid.Height(); j++)
 				{
-					switch (grid(i, j))
-					{
-					case OpCode::IPStart:
-						ipStartX = i;
-						ipStartY = j;
-						break;
-
-					case OpCode::SelectionStart:
-						selStartX = i;
-						selStartY = j;
-						break;
-					}
-				}
-			}
-
-			if (ipStartX >= 0 && ipStartY >= 0 && selStartX >= 0 && selStartY >= 0)
-			{
-				{
-					Grid temp(grid);
-					grid.QueueAddCursor(ipStartX, ipStartY, selStartX, selStartY);
+					// run a copy, so the program's writes never reach the saved grid
 					grid.AddCursors();
+					Grid running(grid);
+					grid.Stop();
+
+					running.ResetCounters();
+					running.SetTiming(true);
+					PerformanceMeter meter;
+					bool hud = true;
+					bool paused = false;
+					debugger.Resume();
 					while (true)
 					{
+						bool step = !paused;
+
 						terminal_clear();
-						grid.Print();
+						running.Print();
+						debugger.Print(running);
+						if (hud) { DrawHud(running, meter); }
+						if (paused) { DrawStop(debugger.Stop()); }
 						terminal_refresh();
+						meter.Sample(running);
 						if (terminal_has_input())
 						{
 							int code = terminal_read();
@@ -133,14 +243,31 @@ int main()
 							{
 								break;
 							}
+							else if (code == TK_F1)
+							{
+								hud = !hud;
+							}
+							else if (code == TK_SPACE)
+							{
+								paused = !paused;
+								debugger.Resume();
+							}
+							else if (code == TK_N && paused)
+							{
+								step = true;
+							}
 						}
 						terminal_delay(100);
 
-						if (!grid.Update()) { break; }
-						grid.AddCursors();
-					}
+						if (!step) { continue; }
 
-					grid = std::move(temp);
+						// without anything to stop on, skip the hooks entirely
+						const bool alive = debugger.Empty() ? running.Update() : running.Update(debugger);
+						if (!alive) { break; }
+						running.AddCursors();
+
+						if (debugger.Stopped()) { paused = true; }
+					}
 				}
 
 				while (terminal_has_input())
@@ -150,6 +277,7 @@ int main()
 
 				terminal_clear();
 				grid.Print();
+				debugger.Print(grid);
 
 				terminal_color(0xFFFF0000);
 				terminal_layer(2);
@@ -163,15 +291,18 @@ int main()
 		if (inputChar)
 		{
 			grid(x, y) = inputChar;
+			if (!mapped) { journal.Record(grid, x, y); }
 			if (++x >= grid.Width()) { x--; }
 		}
 		else if (terminal_state(TK_BACKSPACE))
 		{
 			grid(x, y) = OpCode::None;
+			if (!mapped) { journal.Record(grid, x, y); }
 			if (--x < 0) { x = 0; }
 		}
 
 		grid.Print();
+		debugger.Print(grid);
 
 		terminal_color(0xFFFF0000);
 		terminal_layer(2);
@@ -182,10 +313,5 @@ int main()
 
 	terminal_close();
 
-	{
-		std::ofstream out("autosave.e2d", std::ios_base::binary);
-		out << grid;
-	}
-
 	return 0;
 }
\ No newline at end of file
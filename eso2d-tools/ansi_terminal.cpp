@@ -0,0 +1,240 @@
+#include "ansi_terminal.h"
+#include "eso2d.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+static const uint32_t defaultColor = 0xFFFFFFFF;
+
+void Put(int x, int y, int code)
+{
+	Terminal().Put(x, y, code);
+}
+
+void Layer(int layer)
+{
+	Terminal().SetLayer(layer);
+}
+
+void SetColor(uint32_t color)
+{
+	Terminal().SetColor(color);
+}
+
+uint32_t MakeColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	return (uint32_t(a) << 24) | (uint32_t(r) << 16) | (uint32_t(g) << 8) | uint32_t(b);
+}
+
+AnsiTerminal& Terminal()
+{
+	static AnsiTerminal terminal;
+	return terminal;
+}
+
+static void AppendNumber(std::string& out, int value)
+{
+	char digits[12];
+	int length = std::snprintf(digits, sizeof(digits), "%d", value);
+	out.append(digits, length);
+}
+
+static void AppendCode(std::string& out, int code)
+{
+	// control characters and invalid code points would corrupt the display
+	if (code < ' ' || code == 0x7F || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+	{
+		code = ' ';
+	}
+
+	if (code < 0x80)
+	{
+		out += static_cast<char>(code);
+	}
+	else if (code < 0x800)
+	{
+		out += static_cast<char>(0xC0 | (code >> 6));
+		out += static_cast<char>(0x80 | (code & 0x3F));
+	}
+	else if (code < 0x10000)
+	{
+		out += static_cast<char>(0xE0 | (code >> 12));
+		out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (code & 0x3F));
+	}
+	else
+	{
+		out += static_cast<char>(0xF0 | (code >> 18));
+		out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+		out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (code & 0x3F));
+	}
+}
+
+AnsiTerminal::AnsiTerminal() : width(0), height(0), layer(0), color(defaultColor), open(false) { }
+
+AnsiTerminal::~AnsiTerminal()
+{
+	Close();
+}
+
+void AnsiTerminal::Open(int width, int height)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+	DWORD mode = 0;
+	if (GetConsoleMode(console, &mode))
+	{
+		SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+	}
+	SetConsoleOutputCP(CP_UTF8);
+#endif
+
+	this->width = width;
+	this->height = height;
+	layers.clear();
+	layer = 0;
+	color = defaultColor;
+
+	// nothing on screen matches a real cell, so the first refresh draws everything
+	screen.assign(width * height, Cell { -1, 0 });
+
+	// alternate screen, hide cursor, clear
+	output = "\x1b[?1049h\x1b[?25l\x1b[2J";
+	std::fwrite(output.data(), 1, output.size(), stdout);
+	std::fflush(stdout);
+	open = true;
+}
+
+void AnsiTerminal::Close()
+{
+	if (!open) { return; }
+
+	// reset color, show cursor, leave alternate screen
+	output = "\x1b[0m\x1b[?25h\x1b[?1049l";
+	std::fwrite(output.data(), 1, output.size(), stdout);
+	std::fflush(stdout);
+	open = false;
+}
+
+bool AnsiTerminal::IsOpen() const { return open; }
+
+int AnsiTerminal::Width() const { return width; }
+int AnsiTerminal::Height() const { return height; }
+
+void AnsiTerminal::Clear()
+{
+	for (auto& entry : layers)
+	{
+		std::fill(entry.second.begin(), entry.second.end(), Cell { 0, 0 });
+	}
+}
+
+void AnsiTerminal::SetLayer(int layer)
+{
+	this->layer = layer;
+}
+
+void AnsiTerminal::SetColor(uint32_t color)
+{
+	this->color = color;
+}
+
+void AnsiTerminal::Put(int x, int y, int code)
+{
+	if (x < 0 || y < 0 || x >= width || y >= height) { return; }
+
+	CurrentLayer()[x + y * width] = Cell { code, color };
+}
+
+void AnsiTerminal::Print(int x, int y, const std::string& text)
+{
+	for (char c : text)
+	{
+		Put(x++, y, static_cast<unsigned char>(c));
+	}
+}
+
+void AnsiTerminal::Refresh()
+{
+	if (!open) { return; }
+
+	output.clear();
+
+	int cursorX = -1;
+	int cursorY = -1;
+	uint32_t cursorColor = 0;
+	bool colorSet = false;
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const int index = x + y * width;
+
+			// topmost non-empty layer wins
+			Cell cell = { ' ', defaultColor };
+			for (auto it = layers.rbegin(); it != layers.rend(); ++it)
+			{
+				if (it->second[index].code != 0)
+				{
+					cell = it->second[index];
+					break;
+				}
+			}
+
+			if (cell == screen[index]) { continue; }
+			screen[index] = cell;
+
+			if (x != cursorX || y != cursorY)
+			{
+				output += "\x1b[";
+				AppendNumber(output, y + 1);
+				output += ';';
+				AppendNumber(output, x + 1);
+				output += 'H';
+			}
+
+			if (!colorSet || cell.color != cursorColor)
+			{
+				output += "\x1b[38;2;";
+				AppendNumber(output, (cell.color >> 16) & 0xFF);
+				output += ';';
+				AppendNumber(output, (cell.color >> 8) & 0xFF);
+				output += ';';
+				AppendNumber(output, cell.color & 0xFF);
+				output += 'm';
+				cursorColor = cell.color;
+				colorSet = true;
+			}
+
+			AppendCode(output, cell.code);
+			cursorX = x + 1;
+			cursorY = y;
+		}
+	}
+
+	if (!output.empty())
+	{
+		std::fwrite(output.data(), 1, output.size(), stdout);
+		std::fflush(stdout);
+	}
+}
+
+std::vector<AnsiTerminal::Cell>& AnsiTerminal::CurrentLayer()
+{
+	std::vector<Cell>& cells = layers[layer];
+	if (cells.size() != screen.size())
+	{
+		cells.assign(screen.size(), Cell { 0, 0 });
+	}
+	return cells;
+}
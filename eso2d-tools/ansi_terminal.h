@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Draws to a plain ANSI/VT terminal, keeping an off-screen buffer per layer.
+/// Refresh composites the layers and writes only the cells that changed since the last frame, in a single write.
+/// Put, Layer and SetColor draw through the shared instance returned by Terminal().
+/// </summary>
+class AnsiTerminal
+{
+public:
+	AnsiTerminal();
+	~AnsiTerminal();
+
+	AnsiTerminal(const AnsiTerminal&) = delete;
+	AnsiTerminal& operator=(const AnsiTerminal&) = delete;
+
+	/// <summary>
+	/// Switch to the alternate screen and start drawing.
+	/// </summary>
+	/// <param name="width">Width in cells.</param>
+	/// <param name="height">Height in cells.</param>
+	void Open(int width, int height);
+	/// <summary>
+	/// Restore the terminal. Safe to call more than once.
+	/// </summary>
+	void Close();
+	bool IsOpen() const;
+
+	int Width() const;
+	int Height() const;
+
+	/// <summary>
+	/// Clear every layer. The screen is only updated on the next Refresh.
+	/// </summary>
+	void Clear();
+	/// <summary>
+	/// Set the layer later draws go to. Higher layers are drawn over lower ones.
+	/// </summary>
+	void SetLayer(int layer);
+	/// <summary>
+	/// Set the foreground color later draws use, as 0xAARRGGBB.
+	/// </summary>
+	void SetColor(uint32_t color);
+	/// <summary>
+	/// Draw a character to the current layer. Draws outside the terminal are ignored.
+	/// </summary>
+	void Put(int x, int y, int code);
+	/// <summary>
+	/// Draw a string to the current layer, starting at (x, y).
+	/// </summary>
+	void Print(int x, int y, const std::string& text);
+	/// <summary>
+	/// Write every cell that changed since the last refresh.
+	/// </summary>
+	void Refresh();
+
+private:
+	struct Cell
+	{
+		int code;
+		uint32_t color;
+
+		bool operator==(const Cell& other) const { return code == other.code && color == other.color; }
+		bool operator!=(const Cell& other) const { return !(*this == other); }
+	};
+
+	std::vector<Cell>& CurrentLayer();
+
+	int width;
+	int height;
+	int layer;
+	uint32_t color;
+	bool open;
+
+	std::map<int, std::vector<Cell>> layers;
+	// what the terminal is currently showing
+	std::vector<Cell> screen;
+	std::string output;
+};
+
+/// <summary>
+/// Terminal used by the Put, Layer and SetColor functions.
+/// </summary>
+AnsiTerminal& Terminal();
@@ -0,0 +1,141 @@
+#include "commands.h"
+#include "engines.h"
+#include "reference.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct BenchResult
+{
+	double seconds;
+	uint64_t steps;
+	uint64_t executions;
+};
+
+// run one program to completion, or until it reaches the step or cursor limit
+static void Bench(const Grid& program, const Engine& engine, uint64_t maxSteps, size_t maxCursors, BenchResult& result)
+{
+	Grid grid(program);
+	grid.ResetCounters();
+
+	const auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < maxSteps && grid.Cursors().size() <= maxCursors; i++)
+	{
+		const bool alive = engine.update(grid);
+		grid.AddCursors();
+		if (!alive) { break; }
+	}
+	result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.steps += grid.Counters().steps;
+	result.executions += grid.Counters().executions;
+}
+
+int BenchCommand(int argc, char** argv)
+{
+	const char* only = nullptr;
+	uint64_t steps = 2000;
+	size_t maxCursors = 100000;
+	unsigned long randomCount = 0;
+	uint32_t seed = 1;
+	int width = 64;
+	int height = 64;
+	GridLayout layout = GridLayout::RowMajor;
+	std::vector<Grid> corpus;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+		{
+			only = argv[++i];
+			if (!FindEngine(only)) { return 1; }
+		}
+		else if (std::strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+		{
+			if (!ParseLayout(argv[++i], layout)) { return 1; }
+		}
+		else if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+		{
+			steps = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-cursors") == 0 && i + 1 < argc)
+		{
+			maxCursors = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--random") == 0 && i + 1 < argc)
+		{
+			randomCount = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			seed = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+		{
+			width = std::atoi(argv[++i]);
+			height = std::atoi(argv[++i]);
+		}
+		else
+		{
+			Grid program(1, 1);
+			if (!LoadGrid(argv[i], program) || !program.QueueStartCursor())
+			{
+				std::cerr << "skipping " << argv[i] << std::endl;
+				continue;
+			}
+			program.AddCursors();
+			// copy, so a mapped program is not written to
+			corpus.push_back(Grid(program));
+		}
+	}
+
+	if (corpus.empty() && randomCount == 0) { randomCount = 200; }
+	if (width < 1 || height < 1)
+	{
+		std::cerr << "invalid size" << std::endl;
+		return 1;
+	}
+
+	for (unsigned long i = 0; i < randomCount; i++, seed++)
+	{
+		Grid program = GenerateProgram(width, height, seed);
+		if (!program.QueueStartCursor()) { continue; }
+		program.AddCursors();
+		corpus.push_back(std::move(program));
+	}
+
+	for (Grid& program : corpus)
+	{
+		program.SetLayout(layout);
+	}
+
+	std::cout << corpus.size() << " programs, up to " << steps << " steps and " << maxCursors << " cursors each" << std::endl;
+
+	double serialSeconds = 0.0;
+	for (size_t e = 0; e < engineCount; e++)
+	{
+		const Engine& engine = engines[e];
+		// the serial engine always runs, as the baseline
+		if (only && e > 0 && std::strcmp(only, engine.name) != 0) { continue; }
+
+		BenchResult result = { };
+		for (const Grid& program : corpus)
+		{
+			Bench(program, engine, steps, maxCursors, result);
+		}
+		if (e == 0) { serialSeconds = result.seconds; }
+
+		char line[128];
+		std::snprintf(line, sizeof(line), "%-10s %9.3f s %14.0f steps/s %14.0f instructions/s %7.2fx",
+			engine.name, result.seconds,
+			result.seconds > 0.0 ? result.steps / result.seconds : 0.0,
+			result.seconds > 0.0 ? result.executions / result.seconds : 0.0,
+			result.seconds > 0.0 ? serialSeconds / result.seconds : 0.0);
+		std::cout << line << std::endl;
+	}
+
+	return 0;
+}
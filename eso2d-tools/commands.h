@@ -0,0 +1,84 @@
+#pragma once
+
+#include "eso2d.h"
+
+/// <summary>
+/// Check the end of a path.
+/// </summary>
+/// <param name="path">Path to check.</param>
+/// <param name="extension">Extension, including the dot.</param>
+/// <returns>True if the path ends in the extension and has a name before it.</returns>
+bool HasExtension(const char* path, const char* extension);
+/// <summary>
+/// Load a grid saved by the console. Files ending in .e2dm are mapped rather than read.
+/// Files ending in .e2dc are checkpoints, restored along with their cursors and counters.
+/// </summary>
+/// <param name="path">File to load.</param>
+/// <param name="grid">Replaced with the loaded grid on success.</param>
+/// <returns>True if the file was read, false otherwise. Prints an error on failure.</returns>
+bool LoadGrid(const char* path, Grid& grid);
+/// <summary>
+/// Read a grid saved by the console, like operator&gt;&gt;, but refuse a size the rest of the input cannot hold before allocating anything.
+/// Without this check a short header naming a huge size makes the grid allocation throw.
+/// </summary>
+/// <param name="in">Seekable input, such as a file or string stream.</param>
+/// <param name="grid">Replaced with the grid on success, keeping its layout.</param>
+/// <returns>True if read, false otherwise.</returns>
+bool ReadGrid(std::istream& in, Grid& grid);
+/// <summary>
+/// Parse a layout name, "row" or "blocked".
+/// </summary>
+/// <param name="name">Layout name.</param>
+/// <param name="layout">Set to the layout on success.</param>
+/// <returns>True if the name is a layout, false otherwise. Prints an error on failure.</returns>
+bool ParseLayout(const char* name, GridLayout& layout);
+/// <summary>
+/// Describe a grid status, e.g. "finished" or "step limit".
+/// </summary>
+/// <param name="status">Status to describe.</param>
+/// <returns>Lowercase description.</returns>
+const char* StatusName(GridStatus status);
+/// <summary>
+/// Hash bytes with SHA-256. Used to recognise programs the server has already loaded, so it must not be possible to make two programs share a hash.
+/// </summary>
+/// <param name="data">Bytes to hash.</param>
+/// <param name="size">Number of bytes.</param>
+/// <returns>The hash as 64 lowercase hex digits.</returns>
+std::string ContentHash(const void* data, size_t size);
+
+/// <summary>
+/// run &lt;program.e2d|checkpoint.e2dc&gt; [--fps n] [--steps-per-frame n] [--max-steps n] [--max-cursors n] [--max-writes n] [--time-limit-ms n] [--engine name] [--headless] [--publish name [--publish-ms n]] [--checkpoint file.e2dc [--checkpoint-ms n]]
+/// </summary>
+int RunCommand(int argc, char** argv);
+/// <summary>
+/// record &lt;program.e2d&gt; &lt;trace.e2dt&gt; [max steps]
+/// </summary>
+int RecordCommand(int argc, char** argv);
+/// <summary>
+/// trace &lt;trace.e2dt&gt; [step &lt;n&gt; [out.e2d]]
+/// </summary>
+int TraceCommand(int argc, char** argv);
+/// <summary>
+/// diff [--engine name] [--layout row|blocked] [--steps n] [--random count] [--seed s] [--size w h] [programs...]
+/// </summary>
+int DiffCommand(int argc, char** argv);
+/// <summary>
+/// bench [--engine name] [--layout row|blocked] [--steps n] [--max-cursors n] [--random count] [--seed s] [--size w h] [programs...]
+/// </summary>
+int BenchCommand(int argc, char** argv);
+/// <summary>
+/// view &lt;name&gt; [--fps n]
+/// </summary>
+int ViewCommand(int argc, char** argv);
+/// <summary>
+/// serve &lt;socket&gt; [--workers n] [--cache n] [--max-steps n] [--max-cursors n] [--max-writes n] [--time-limit-ms n]
+/// </summary>
+int ServeCommand(int argc, char** argv);
+/// <summary>
+/// submit &lt;socket&gt; &lt;program.e2d&gt; [--engine name] [--layout row|blocked] [--patch x y value]... [--max-steps n] [--max-cursors n] [--max-writes n] [--time-limit-ms n] [--progress-ms n] [--out result.e2d]
+/// </summary>
+int SubmitCommand(int argc, char** argv);
+/// <summary>
+/// selftest [name filter]
+/// </summary>
+int SelfTestCommand(int argc, char** argv);
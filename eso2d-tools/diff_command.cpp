@@ -0,0 +1,160 @@
+#include "commands.h"
+#include "engines.h"
+#include "reference.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+static void Report(const Engine& engine, const std::string& program, const Divergence& divergence)
+{
+	std::cout << engine.name << " diverged on " << program << " after step " << divergence.step << ": ";
+	switch (divergence.kind)
+	{
+	case Divergence::Finished:
+		std::cout << "reference " << (divergence.expected ? "kept running" : "stopped")
+			<< ", engine " << (divergence.actual ? "kept running" : "stopped") << std::endl;
+		break;
+
+	case Divergence::CursorCount:
+		std::cout << "reference has " << divergence.expected << " cursors, engine has " << divergence.actual << std::endl;
+		break;
+
+	case Divergence::CursorState:
+		std::cout << "cursor " << divergence.cursor << " differs" << std::endl;
+		break;
+
+	case Divergence::Cell:
+		std::cout << "cell (" << divergence.x << ", " << divergence.y << ") is " << divergence.actual
+			<< ", reference has " << divergence.expected << std::endl;
+		break;
+
+	default:
+		std::cout << std::endl;
+		break;
+	}
+}
+
+// returns false if any engine diverged
+static bool Check(const Grid& original, GridLayout layout, const std::string& name, const char* only, uint64_t steps)
+{
+	Grid program(original);
+	program.SetLayout(layout);
+
+	bool agreed = true;
+	for (size_t i = 0; i < engineCount; i++)
+	{
+		const Engine& engine = engines[i];
+		if (only && std::strcmp(only, engine.name) != 0) { continue; }
+
+		Divergence divergence = RunDifferential(program, engine.update, steps);
+		if (divergence.kind != Divergence::None)
+		{
+			Report(engine, name, divergence);
+			agreed = false;
+		}
+	}
+	return agreed;
+}
+
+// check count generated programs from seed on. returns the number that diverged, and adds the number checked to programs
+static int CheckRandom(unsigned long count, uint32_t seed, int width, int height, GridLayout layout, const char* only, uint64_t steps, int& programs)
+{
+	int failures = 0;
+	for (unsigned long i = 0; i < count; i++, seed++)
+	{
+		Grid program = GenerateProgram(width, height, seed);
+		if (!program.QueueStartCursor()) { continue; }
+		program.AddCursors();
+
+		programs++;
+		const std::string name = "seed " + std::to_string(seed);
+		if (!Check(program, layout, name, only, steps))
+		{
+			failures++;
+
+			Grid saved = GenerateProgram(width, height, seed);
+			const std::string path = "divergence-" + std::to_string(seed) + ".e2d";
+			std::ofstream out(path, std::ios_base::binary);
+			out << saved;
+			std::cout << "  program saved to " << path << std::endl;
+		}
+	}
+	return failures;
+}
+
+int DiffCommand(int argc, char** argv)
+{
+	// the default run also covers wide grids, whose selections can hold numbers too large for an int
+	const unsigned long wideCount = 200;
+	const uint32_t wideSeed = 9000;
+	const int wideSize = 64;
+
+	const char* only = nullptr;
+	uint64_t steps = 2000;
+	unsigned long randomCount = 0;
+	uint32_t seed = 1;
+	int width = 32;
+	int height = 16;
+	GridLayout layout = GridLayout::RowMajor;
+	int failures = 0;
+	int programs = 0;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+		{
+			only = argv[++i];
+			if (!FindEngine(only)) { return 1; }
+		}
+		else if (std::strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+		{
+			if (!ParseLayout(argv[++i], layout)) { return 1; }
+		}
+		else if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+		{
+			steps = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--random") == 0 && i + 1 < argc)
+		{
+			randomCount = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			seed = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+		{
+			width = std::atoi(argv[++i]);
+			height = std::atoi(argv[++i]);
+		}
+		else
+		{
+			Grid program(1, 1);
+			if (!LoadGrid(argv[i], program) || !program.QueueStartCursor())
+			{
+				std::cerr << "skipping " << argv[i] << std::endl;
+				continue;
+			}
+			program.AddCursors();
+
+			programs++;
+			if (!Check(program, layout, argv[i], only, steps)) { failures++; }
+		}
+	}
+
+	const bool defaultRun = programs == 0 && randomCount == 0;
+	if (defaultRun) { randomCount = 1000; }
+	if (width < 1 || height < 1)
+	{
+		std::cerr << "invalid size" << std::endl;
+		return 1;
+	}
+
+	failures += CheckRandom(randomCount, seed, width, height, layout, only, steps, programs);
+	if (defaultRun) { failures += CheckRandom(wideCount, wideSeed, wideSize, wideSize, layout, only, steps, programs); }
+
+	std::cout << programs << " programs, " << failures << " diverged" << std::endl;
+	return failures == 0 ? 0 : 2;
+}
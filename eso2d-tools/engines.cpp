@@ -0,0 +1,45 @@
+#include "engines.h"
+#include "batched.h"
+#include "threaded.h"
+
+#include <cstring>
+
+static bool SerialUpdate(Grid& grid) { return grid.Update(); }
+
+// steppers keep buffers between steps, so keep one per thread
+static bool BatchedUpdate(Grid& grid)
+{
+	thread_local BatchedStepper stepper;
+	return stepper.Update(grid);
+}
+
+static bool ThreadedUpdate(Grid& grid)
+{
+	thread_local ThreadedStepper stepper;
+	return stepper.Update(grid);
+}
+
+const Engine engines[] =
+{
+	{ "serial", SerialUpdate },
+	{ "batched", BatchedUpdate },
+	{ "threaded", ThreadedUpdate }
+};
+
+const size_t engineCount = sizeof(engines) / sizeof(engines[0]);
+
+const Engine* FindEngine(const char* name)
+{
+	for (size_t i = 0; i < engineCount; i++)
+	{
+		if (std::strcmp(engines[i].name, name) == 0) { return &engines[i]; }
+	}
+
+	std::cerr << "unknown engine " << name << ", expected one of:";
+	for (size_t i = 0; i < engineCount; i++)
+	{
+		std::cerr << " " << engines[i].name;
+	}
+	std::cerr << std::endl;
+	return nullptr;
+}
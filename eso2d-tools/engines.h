@@ -0,0 +1,25 @@
+#pragma once
+
+#include "eso2d.h"
+
+#include <cstddef>
+
+/// <summary>
+/// A way of stepping a grid. Every engine must give the same results as Grid::Update.
+/// </summary>
+struct Engine
+{
+	const char* name;
+	bool (*update)(Grid&);
+};
+
+// every engine, with the serial interpreter first
+extern const Engine engines[];
+extern const size_t engineCount;
+
+/// <summary>
+/// Find an engine by name.
+/// </summary>
+/// <param name="name">Engine name.</param>
+/// <returns>The engine, or nullptr after printing the valid names.</returns>
+const Engine* FindEngine(const char* name);
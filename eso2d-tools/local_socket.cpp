@@ -0,0 +1,346 @@
+#include "local_socket.h"
+
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+typedef SOCKET NativeSocket;
+
+static bool Startup()
+{
+	static const bool started = []
+	{
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+	return started;
+}
+
+static void CloseNative(NativeSocket socket) { closesocket(socket); }
+static void RemovePath(const std::string& path) { DeleteFileA(path.c_str()); }
+
+static bool WaitReadable(NativeSocket socket, int timeoutMilliseconds)
+{
+	WSAPOLLFD entry = { socket, POLLRDNORM, 0 };
+	return WSAPoll(&entry, 1, timeoutMilliseconds) > 0;
+}
+
+static long SendSome(NativeSocket socket, const char* data, size_t size)
+{
+	return send(socket, data, static_cast<int>(size < 0x40000000 ? size : 0x40000000), 0);
+}
+
+static long ReceiveSome(NativeSocket socket, char* data, size_t size)
+{
+	return recv(socket, data, static_cast<int>(size), 0);
+}
+
+static long PeekSome(NativeSocket socket, char* data, size_t size)
+{
+	return recv(socket, data, static_cast<int>(size), MSG_PEEK);
+}
+
+#else
+
+typedef int NativeSocket;
+
+static bool Startup() { return true; }
+static void CloseNative(NativeSocket socket) { close(socket); }
+static void RemovePath(const std::string& path) { unlink(path.c_str()); }
+
+static bool WaitReadable(NativeSocket socket, int timeoutMilliseconds)
+{
+	pollfd entry = { socket, POLLIN, 0 };
+	return poll(&entry, 1, timeoutMilliseconds) > 0;
+}
+
+static long SendSome(NativeSocket socket, const char* data, size_t size)
+{
+	// a peer that hung up is reported as a failed send, rather than by SIGPIPE
+#ifdef MSG_NOSIGNAL
+	return send(socket, data, size, MSG_NOSIGNAL);
+#else
+	return send(socket, data, size, 0);
+#endif
+}
+
+static long ReceiveSome(NativeSocket socket, char* data, size_t size)
+{
+	return recv(socket, data, size, 0);
+}
+
+static long PeekSome(NativeSocket socket, char* data, size_t size)
+{
+	return recv(socket, data, size, MSG_PEEK);
+}
+
+#endif
+
+static const intptr_t closedHandle = -1;
+
+// longest single wait while receiving, so a cancel is noticed promptly
+static const int cancelCheckMilliseconds = 100;
+
+static NativeSocket Native(intptr_t handle) { return static_cast<NativeSocket>(handle); }
+
+// fill in an address for path. false if the path is too long to fit
+static bool MakeAddress(const std::string& path, sockaddr_un& address)
+{
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(address.sun_path)) { return false; }
+	std::memcpy(address.sun_path, path.c_str(), path.size());
+	return true;
+}
+
+LocalSocket::LocalSocket() : handle(closedHandle), bufferStart(0), receiveTimeout(-1), cancel(nullptr) { }
+
+LocalSocket::~LocalSocket()
+{
+	Close();
+}
+
+LocalSocket::LocalSocket(LocalSocket&& other) noexcept : handle(other.handle), path(std::move(other.path)), buffer(std::move(other.buffer)), bufferStart(other.bufferStart),
+	receiveTimeout(other.receiveTimeout), cancel(other.cancel)
+{
+	other.handle = closedHandle;
+	other.path.clear();
+	other.bufferStart = 0;
+}
+
+LocalSocket& LocalSocket::operator=(LocalSocket&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		handle = other.handle;
+		path = std::move(other.path);
+		buffer = std::move(other.buffer);
+		bufferStart = other.bufferStart;
+		receiveTimeout = other.receiveTimeout;
+		cancel = other.cancel;
+		other.handle = closedHandle;
+		other.path.clear();
+		other.bufferStart = 0;
+	}
+	return *this;
+}
+
+bool LocalSocket::Listen(const std::string& path)
+{
+	Close();
+
+	sockaddr_un address;
+	if (!Startup() || !MakeAddress(path, address)) { return false; }
+
+	// a path that still accepts connections belongs to a live server
+	{
+		LocalSocket probe;
+		if (probe.Connect(path)) { return false; }
+	}
+	RemovePath(path);
+
+	const NativeSocket socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (static_cast<intptr_t>(socket) == closedHandle) { return false; }
+
+	if (bind(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		CloseNative(socket);
+		return false;
+	}
+	if (listen(socket, 64) != 0)
+	{
+		CloseNative(socket);
+		RemovePath(path);
+		return false;
+	}
+
+	handle = static_cast<intptr_t>(socket);
+	this->path = path;
+	return true;
+}
+
+bool LocalSocket::Accept(LocalSocket& client, int timeoutMilliseconds)
+{
+	if (!IsOpen() || !WaitReadable(Native(handle), timeoutMilliseconds)) { return false; }
+
+	const NativeSocket socket = accept(Native(handle), nullptr, nullptr);
+	if (static_cast<intptr_t>(socket) == closedHandle) { return false; }
+
+	client.Close();
+	client.handle = static_cast<intptr_t>(socket);
+	return true;
+}
+
+bool LocalSocket::Connect(const std::string& path)
+{
+	Close();
+
+	sockaddr_un address;
+	if (!Startup() || !MakeAddress(path, address)) { return false; }
+
+	const NativeSocket socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (static_cast<intptr_t>(socket) == closedHandle) { return false; }
+
+	if (connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		CloseNative(socket);
+		return false;
+	}
+
+	handle = static_cast<intptr_t>(socket);
+	return true;
+}
+
+void LocalSocket::Close()
+{
+	if (handle != closedHandle)
+	{
+		CloseNative(Native(handle));
+		handle = closedHandle;
+	}
+	if (!path.empty())
+	{
+		RemovePath(path);
+		path.clear();
+	}
+	buffer.clear();
+	bufferStart = 0;
+}
+
+bool LocalSocket::IsOpen() const { return handle != closedHandle; }
+
+bool LocalSocket::PeerClosed()
+{
+	if (!IsOpen()) { return true; }
+	if (!WaitReadable(Native(handle), 0)) { return false; }
+
+	// readable with nothing to read is a hang up. peeking leaves any real bytes for the next receive
+	char byte;
+	return PeekSome(Native(handle), &byte, 1) <= 0;
+}
+
+bool LocalSocket::Send(const void* data, size_t size)
+{
+	if (!IsOpen()) { return false; }
+
+	const char* bytes = static_cast<const char*>(data);
+	while (size > 0)
+	{
+		const long sent = SendSome(Native(handle), bytes, size);
+		if (sent <= 0) { return false; }
+		bytes += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+bool LocalSocket::SendLine(const std::string& line)
+{
+	const std::string text = line + '\n';
+	return Send(text.data(), text.size());
+}
+
+void LocalSocket::SetReceiveTimeout(int idleMilliseconds, const std::atomic<bool>* cancel)
+{
+	receiveTimeout = idleMilliseconds;
+	this->cancel = cancel;
+}
+
+bool LocalSocket::WaitToReceive()
+{
+	// nothing to watch for, so let recv block
+	if (receiveTimeout < 0 && !cancel) { return true; }
+
+	const auto start = std::chrono::steady_clock::now();
+	for (;;)
+	{
+		if (cancel && *cancel) { return false; }
+
+		int wait = cancel ? cancelCheckMilliseconds : receiveTimeout;
+		if (receiveTimeout >= 0)
+		{
+			const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			if (waited >= receiveTimeout) { return false; }
+			if (receiveTimeout - waited < wait) { wait = static_cast<int>(receiveTimeout - waited); }
+		}
+		// ready also covers a hang up, which the receive then reports
+		if (WaitReadable(Native(handle), wait)) { return true; }
+	}
+}
+
+bool LocalSocket::Fill()
+{
+	if (!IsOpen() || !WaitToReceive()) { return false; }
+
+	// drop what has already been returned before reading more
+	if (bufferStart > 0)
+	{
+		buffer.erase(0, bufferStart);
+		bufferStart = 0;
+	}
+
+	char chunk[65536];
+	const long received = ReceiveSome(Native(handle), chunk, sizeof(chunk));
+	if (received <= 0) { return false; }
+	buffer.append(chunk, static_cast<size_t>(received));
+	return true;
+}
+
+bool LocalSocket::Receive(void* data, size_t size)
+{
+	char* bytes = static_cast<char*>(data);
+
+	const size_t buffered = buffer.size() - bufferStart < size ? buffer.size() - bufferStart : size;
+	std::memcpy(bytes, buffer.data() + bufferStart, buffered);
+	bufferStart += buffered;
+	bytes += buffered;
+	size -= buffered;
+
+	// the rest goes straight to the caller, without passing through the buffer
+	while (size > 0)
+	{
+		if (!IsOpen() || !WaitToReceive()) { return false; }
+		const long received = ReceiveSome(Native(handle), bytes, size);
+		if (received <= 0) { return false; }
+		bytes += received;
+		size -= static_cast<size_t>(received);
+	}
+	return true;
+}
+
+bool LocalSocket::ReceiveLine(std::string& line, size_t maxLength)
+{
+	size_t searched = bufferStart;
+	for (;;)
+	{
+		const size_t end = buffer.find('\n', searched);
+		if (end != std::string::npos)
+		{
+			if (end - bufferStart > maxLength) { return false; }
+			line.assign(buffer, bufferStart, end - bufferStart);
+			bufferStart = end + 1;
+			return true;
+		}
+		if (buffer.size() - bufferStart > maxLength) { return false; }
+
+		searched = buffer.size() - bufferStart;
+		if (!Fill()) { return false; }
+		// Fill moves the unreturned bytes to the front
+		searched += bufferStart;
+	}
+}
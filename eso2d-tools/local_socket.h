@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// A stream socket on a local path, for talking to another process on the same machine.
+/// Uses Unix domain sockets, which Windows 10 and later also provide through winsock.
+/// A listening socket owns its path: it is removed when the socket closes.
+/// </summary>
+class LocalSocket
+{
+public:
+	LocalSocket();
+	~LocalSocket();
+
+	LocalSocket(const LocalSocket&) = delete;
+	LocalSocket& operator=(const LocalSocket&) = delete;
+	LocalSocket(LocalSocket&& other) noexcept;
+	LocalSocket& operator=(LocalSocket&& other) noexcept;
+
+	/// <summary>
+	/// Listen for connections on a path.
+	/// A socket file left by a crashed server is replaced, but a path a live server is listening on is not.
+	/// </summary>
+	/// <param name="path">Path of the socket file.</param>
+	/// <returns>True if listening, false otherwise.</returns>
+	bool Listen(const std::string& path);
+	/// <summary>
+	/// Wait for a connection on a listening socket.
+	/// </summary>
+	/// <param name="client">Replaced with the connection on success.</param>
+	/// <param name="timeoutMilliseconds">Longest time to wait.</param>
+	/// <returns>True if a connection was accepted, false if none arrived in time or accepting failed.</returns>
+	bool Accept(LocalSocket& client, int timeoutMilliseconds);
+	/// <summary>
+	/// Connect to a listening socket.
+	/// </summary>
+	/// <param name="path">Path given to Listen.</param>
+	/// <returns>True if connected, false otherwise.</returns>
+	bool Connect(const std::string& path);
+	/// <summary>
+	/// Close the socket, and remove the path if this was listening on it. Safe to call if nothing is open.
+	/// </summary>
+	void Close();
+	bool IsOpen() const;
+	/// <summary>
+	/// Check, without waiting, whether the peer has closed the connection. Received bytes not yet read are kept.
+	/// </summary>
+	/// <returns>True if the peer hung up or the connection failed, false if it is still open.</returns>
+	bool PeerClosed();
+
+	/// <summary>
+	/// Send every byte, blocking until done.
+	/// </summary>
+	/// <returns>True if sent, false if the connection is gone.</returns>
+	bool Send(const void* data, size_t size);
+	/// <summary>
+	/// Send a line of text, adding the newline.
+	/// </summary>
+	bool SendLine(const std::string& line);
+	/// <summary>
+	/// Give up on receives that wait too long, so a peer that goes quiet cannot hold on to this end forever.
+	/// </summary>
+	/// <param name="idleMilliseconds">Longest wait for the next bytes to arrive, or -1 to wait forever, the default.</param>
+	/// <param name="cancel">If not null, receives fail soon after this becomes true. Must outlive the socket.</param>
+	void SetReceiveTimeout(int idleMilliseconds, const std::atomic<bool>* cancel = nullptr);
+
+	/// <summary>
+	/// Receive exactly size bytes, blocking until they arrive.
+	/// </summary>
+	/// <returns>True if received, false if the connection closed first, timed out or was cancelled.</returns>
+	bool Receive(void* data, size_t size);
+	/// <summary>
+	/// Receive a line of text, without its newline.
+	/// </summary>
+	/// <param name="line">Set to the line on success.</param>
+	/// <param name="maxLength">Longest line accepted. Longer lines fail, as the peer is not speaking the protocol.</param>
+	/// <returns>True if a line was received, false if the connection closed first, timed out, was cancelled or the line was too long.</returns>
+	bool ReceiveLine(std::string& line, size_t maxLength = 4096);
+
+private:
+	// read whatever is available into the buffer. false if the connection closed, timed out or was cancelled
+	bool Fill();
+	// wait until there is something to receive. false if the receive timeout passed or it was cancelled first
+	bool WaitToReceive();
+
+	// SOCKET on Windows, file descriptor elsewhere. -1 if closed
+	intptr_t handle;
+	// path to remove on close, for listening sockets
+	std::string path;
+	// received bytes not yet returned, from bufferStart on
+	std::string buffer;
+	size_t bufferStart;
+	// -1 to wait forever
+	int receiveTimeout;
+	const std::atomic<bool>* cancel;
+};
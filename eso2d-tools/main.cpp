@@ -0,0 +1,156 @@
+#include "commands.h"
+#include "checkpoint.h"
+#include "sha256.h"
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+struct Command
+{
+	const char* name;
+	const char* usage;
+	int (*run)(int argc, char** argv);
+};
+
+static const Command commands[] =
+{
+	{ "run", "run <program.e2d|checkpoint.e2dc> [--fps n] [--steps-per-frame n] [--max-steps n] [--max-cursors n] [--max-writes n] [--time-limit-ms n] [--engine name] [--headless] [--publish name [--publish-ms n]] [--checkpoint file.e2dc [--checkpoint-ms n]]", RunCommand },
+	{ "record", "record <program.e2d> <trace.e2dt> [max steps]", RecordCommand },
+	{ "trace", "trace <trace.e2dt> [step <n> [out.e2d]]", TraceCommand },
+	{ "diff", "diff [--engine name] [--layout row|blocked] [--steps n] [--random count] [--seed s] [--size w h] [programs...]", DiffCommand },
+	{ "bench", "bench [--engine name] [--layout row|blocked] [--steps n] [--max-cursors n] [--random count] [--seed s] [--size w h] [programs...]", BenchCommand },
+	{ "view", "view <name> [--fps n]", ViewCommand },
+	{ "serve", "serve <socket> [--workers n] [--cache n] [--max-steps n] [--max-cursors n] [--max-writes n] [--time-limit-ms n]", ServeCommand },
+	{ "submit", "submit <socket> <program.e2d> [--engine name] [--layout row|blocked] [--patch x y value]... [--max-steps n] [--max-cursors n] [--max-writes n] [--time-limit-ms n] [--progress-ms n] [--out result.e2d]", SubmitCommand },
+	{ "selftest", "selftest [name filter]", SelfTestCommand }
+};
+
+bool HasExtension(const char* path, const char* extension)
+{
+	const size_t length = std::strlen(path);
+	const size_t extensionLength = std::strlen(extension);
+	return length > extensionLength && std::strcmp(path + length - extensionLength, extension) == 0;
+}
+
+bool LoadGrid(const char* path, Grid& grid)
+{
+	if (HasExtension(path, ".e2dm"))
+	{
+		// mapped grids are used in place, so program writes persist to the file
+		if (!std::ifstream(path) || !grid.MapFile(path))
+		{
+			std::cerr << "cannot map grid from " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	if (HasExtension(path, ".e2dc"))
+	{
+		if (!Checkpoint::Load(path, grid))
+		{
+			std::cerr << "cannot read checkpoint from " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	std::ifstream in(path, std::ios_base::binary);
+	if (!in)
+	{
+		std::cerr << "cannot open " << path << std::endl;
+		return false;
+	}
+	if (!ReadGrid(in, grid))
+	{
+		std::cerr << "cannot read grid from " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ReadGrid(std::istream& in, Grid& grid)
+{
+	const std::streampos start = in.tellg();
+	in.seekg(0, std::ios_base::end);
+	const std::streamoff remaining = in.tellg() - start;
+	in.seekg(start);
+
+	int w, h;
+	if (start < 0 || remaining < 0 || !(in >> w >> h) || w <= 0 || h <= 0) { return false; }
+	in.seekg(start);
+
+	// every cell but the last is at least a digit and a separator, so a grid this size cannot be in the input
+	const uint64_t cells = uint64_t(w) * uint64_t(h);
+	if (cells > uint64_t(INT_MAX) || cells * 2 - 1 > uint64_t(remaining)) { return false; }
+	return static_cast<bool>(in >> grid);
+}
+
+bool ParseLayout(const char* name, GridLayout& layout)
+{
+	if (std::strcmp(name, "row") == 0)
+	{
+		layout = GridLayout::RowMajor;
+		return true;
+	}
+	if (std::strcmp(name, "blocked") == 0)
+	{
+		layout = GridLayout::Blocked;
+		return true;
+	}
+
+	std::cerr << "unknown layout " << name << ", expected row or blocked" << std::endl;
+	return false;
+}
+
+const char* StatusName(GridStatus status)
+{
+	switch (status)
+	{
+	case GridStatus::Running: return "running";
+	case GridStatus::Finished: return "finished";
+	case GridStatus::StepLimit: return "step limit";
+	case GridStatus::CursorLimit: return "cursor limit";
+	case GridStatus::WriteLimit: return "write limit";
+	case GridStatus::TimeLimit: return "time limit";
+	}
+	return "unknown";
+}
+
+std::string ContentHash(const void* data, size_t size)
+{
+	uint8_t digest[32];
+	Sha256(data, size, digest);
+
+	static const char digits[] = "0123456789abcdef";
+	std::string hash;
+	for (uint8_t byte : digest)
+	{
+		hash += digits[byte >> 4];
+		hash += digits[byte & 15];
+	}
+	return hash;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc >= 2)
+	{
+		for (const Command& command : commands)
+		{
+			if (std::strcmp(argv[1], command.name) == 0)
+			{
+				return command.run(argc - 2, argv + 2);
+			}
+		}
+	}
+
+	std::cerr << "usage:" << std::endl;
+	for (const Command& command : commands)
+	{
+		std::cerr << "  eso2d-tools " << command.usage << std::endl;
+	}
+	return 1;
+}
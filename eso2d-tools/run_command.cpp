@@ -0,0 +1,214 @@
+#include "commands.h"
+#include "ansi_terminal.h"
+#include "checkpoint.h"
+#include "engines.h"
+#include "performance.h"
+#include "shared_state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void Interrupt(int)
+{
+	interrupted = 1;
+}
+
+// how the run ended, and what it left behind
+static void PrintRunResult(const Grid& grid)
+{
+	const GridCounters& counters = grid.Counters();
+	std::cout << counters.steps << " steps, " << counters.writes << " writes, "
+		<< grid.Cursors().size() << " cursors alive";
+	if (!grid.QueuedCursors().empty())
+	{
+		std::cout << ", " << grid.QueuedCursors().size() << " queued";
+	}
+	std::cout << ", " << (interrupted ? "interrupted" : StatusName(grid.Status())) << std::endl;
+}
+
+// save the final state, so an interrupted run can be resumed from exactly where it stopped
+static bool FinishCheckpoints(CheckpointWriter* checkpoints, const char* path, const Grid& grid)
+{
+	if (!checkpoints) { return true; }
+
+	if (!checkpoints->Save(grid))
+	{
+		std::cerr << "cannot write checkpoint " << path << std::endl;
+		return false;
+	}
+	std::cout << checkpoints->Written() << " checkpoints written to " << path;
+	if (checkpoints->Failed() > 0)
+	{
+		std::cout << ", " << checkpoints->Failed() << " failed";
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+int RunCommand(int argc, char** argv)
+{
+	if (argc < 1)
+	{
+		std::cerr << "usage: eso2d-tools run <program.e2d|checkpoint.e2dc> [--fps n] [--steps-per-frame n] [--max-steps n] [--max-cursors n] [--max-writes n] [--time-limit-ms n] [--engine name] [--headless] [--publish name [--publish-ms n]] [--checkpoint file.e2dc [--checkpoint-ms n]]" << std::endl;
+		return 1;
+	}
+
+	int fps = 30;
+	unsigned long long stepsPerFrame = 1;
+	GridLimits limits = GridLimits();
+	const Engine* engine = &engines[0];
+	bool headless = false;
+	const char* publishName = nullptr;
+	long publishInterval = 100;
+	const char* checkpointPath = nullptr;
+	long checkpointInterval = 60000;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+		{
+			fps = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--steps-per-frame") == 0 && i + 1 < argc)
+		{
+			stepsPerFrame = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc)
+		{
+			limits.maxSteps = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-cursors") == 0 && i + 1 < argc)
+		{
+			limits.maxCursors = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-writes") == 0 && i + 1 < argc)
+		{
+			limits.maxWrites = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--time-limit-ms") == 0 && i + 1 < argc)
+		{
+			limits.timeLimit = std::chrono::milliseconds(std::strtoull(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+		{
+			engine = FindEngine(argv[++i]);
+			if (!engine) { return 1; }
+		}
+		else if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (std::strcmp(argv[i], "--publish") == 0 && i + 1 < argc)
+		{
+			publishName = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--publish-ms") == 0 && i + 1 < argc)
+		{
+			publishInterval = std::atol(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+		{
+			checkpointPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--checkpoint-ms") == 0 && i + 1 < argc)
+		{
+			checkpointInterval = std::atol(argv[++i]);
+		}
+	}
+	if (stepsPerFrame < 1) { stepsPerFrame = 1; }
+
+	Grid grid(1, 1);
+	if (!LoadGrid(argv[0], grid)) { return 1; }
+	// a checkpoint resumes its own cursors
+	if (!HasExtension(argv[0], ".e2dc") && !grid.QueueStartCursor())
+	{
+		std::cerr << "program has no '" << char(OpCode::IPStart) << "' or '" << char(OpCode::SelectionStart) << "'" << std::endl;
+		return 1;
+	}
+	grid.SetLimits(limits);
+	grid.AddCursors();
+
+	const std::chrono::milliseconds interval(publishInterval);
+	StatePublisher publisher(interval);
+	if (publishName && !publisher.Open(publishName, grid))
+	{
+		std::cerr << "cannot publish as " << publishName << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<CheckpointWriter> checkpoints;
+	if (checkpointPath)
+	{
+		checkpoints.reset(new CheckpointWriter(checkpointPath, std::chrono::milliseconds(checkpointInterval)));
+	}
+
+	std::signal(SIGINT, Interrupt);
+
+	if (headless)
+	{
+		// the grid's limits stop the loop, including --max-steps
+		bool alive = grid.Status() == GridStatus::Running;
+		while (!interrupted && alive)
+		{
+			alive = engine->update(grid);
+			grid.AddCursors();
+			publisher.Update(grid);
+			if (checkpoints) { checkpoints->Update(grid); }
+		}
+		publisher.Publish(grid);
+		std::signal(SIGINT, SIG_DFL);
+
+		PrintRunResult(grid);
+		return FinishCheckpoints(checkpoints.get(), checkpointPath, grid) ? 0 : 1;
+	}
+
+	AnsiTerminal& terminal = Terminal();
+	// one extra row for the status line, wide enough to fit it
+	terminal.Open(std::max(grid.Width(), 48), grid.Height() + 1);
+
+	const auto frameTime = fps > 0 ? std::chrono::microseconds(1000000 / fps) : std::chrono::microseconds(0);
+	auto nextFrame = std::chrono::steady_clock::now();
+
+	PerformanceMeter meter;
+	bool alive = grid.Status() == GridStatus::Running;
+	while (!interrupted)
+	{
+		terminal.Clear();
+		grid.Print();
+		terminal.SetLayer(2);
+		terminal.SetColor(MakeColor(0x99, 0x99, 0x99, 0xFF));
+		terminal.Print(0, grid.Height(),
+			"step " + std::to_string(grid.Counters().steps) +
+			"  cursors " + std::to_string(grid.Cursors().size()) +
+			"  steps/s " + std::to_string(static_cast<unsigned long long>(meter.StepsPerSecond())) +
+			(alive ? "" : std::string("  ") + StatusName(grid.Status())));
+		terminal.Refresh();
+		meter.Sample(grid);
+
+		if (!alive) { break; }
+
+		for (unsigned long long i = 0; i < stepsPerFrame && alive; i++)
+		{
+			alive = engine->update(grid);
+			grid.AddCursors();
+			publisher.Update(grid);
+			if (checkpoints) { checkpoints->Update(grid); }
+		}
+
+		nextFrame += frameTime;
+		std::this_thread::sleep_until(nextFrame);
+	}
+
+	terminal.Close();
+	std::signal(SIGINT, SIG_DFL);
+
+	PrintRunResult(grid);
+	return FinishCheckpoints(checkpoints.get(), checkpointPath, grid) ? 0 : 1;
+}
@@ -0,0 +1,485 @@
+#include "commands.h"
+#include "checkpoint.h"
+#include "debugger.h"
+#include "engines.h"
+#include "journal.h"
+#include "local_socket.h"
+#include "reference.h"
+#include "shared_state.h"
+#include "trace.h"
+
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// one regression check. returns true if it passed, printing what went wrong otherwise
+struct SelfTest
+{
+	const char* name;
+	bool (*run)();
+};
+
+static bool Expect(bool condition, const char* what)
+{
+	if (!condition) { std::cout << "  " << what << std::endl; }
+	return condition;
+}
+
+// runs serve on a socket in the working directory, with one worker, until stopped
+class TestServer
+{
+public:
+	TestServer() : path("eso2d-selftest.sock"), result(-1)
+	{
+		thread = std::thread([this]
+		{
+			const char* args[] = { path.c_str(), "--workers", "1" };
+			result = ServeCommand(3, const_cast<char**>(args));
+		});
+
+		// wait for the server to start listening
+		LocalSocket probe;
+		for (int i = 0; i < 100 && !probe.Connect(path); i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+	}
+
+	// stop the server as SIGINT does. true if it stopped cleanly
+	bool Stop()
+	{
+		std::raise(SIGINT);
+		thread.join();
+		return result == 0;
+	}
+
+	// send a program the way submit does, and return the server's reply to it.
+	// the connection is left open in server, so the caller can read more or hang up
+	std::string Submit(const std::string& program, uint64_t maxSteps, LocalSocket& server)
+	{
+		if (!server.Connect(path)) { return "no server"; }
+		// a server that never answers fails the test rather than hanging it
+		server.SetReceiveTimeout(5000);
+
+		const std::string request = "eso2d 1\nlimits " + std::to_string(maxSteps) + " 0 0 0\nprogram " +
+			ContentHash(program.data(), program.size()) + " " + std::to_string(program.size()) + "\nrun\n";
+		std::string line;
+		if (!server.Send(request.data(), request.size()) || !server.ReceiveLine(line) ||
+			(line == "send" && (!server.Send(program.data(), program.size()) || !server.ReceiveLine(line))))
+		{
+			return "lost connection";
+		}
+		return line;
+	}
+
+	std::string Submit(const std::string& program, uint64_t maxSteps)
+	{
+		LocalSocket server;
+		return Submit(program, maxSteps, server);
+	}
+
+private:
+	std::string path;
+	int result;
+	std::thread thread;
+};
+
+static std::string ProgramText(const Grid& program)
+{
+	std::ostringstream text;
+	text << program;
+	return text.str();
+}
+
+// a program whose one cursor circles forever
+static Grid EndlessProgram()
+{
+	Grid program(12, 3);
+	for (int x = 0; x < 12; x++)
+	{
+		program(x, 0) = OpCode::Path;
+		program(x, 2) = OpCode::Path;
+	}
+	program(0, 1) = OpCode::Path;
+	program(11, 1) = OpCode::Path;
+	program(0, 0) = OpCode::IPStart;
+	program(5, 1) = OpCode::SelectionStart;
+	return program;
+}
+
+// run one Increment or Decrement on a selection holding digits, and return the digits afterwards
+static std::string AddOnce(bool (*update)(Grid&), int instruction, const std::string& digits, uint64_t& writes)
+{
+	const int width = static_cast<int>(digits.size());
+	Grid grid(width + 2, 2);
+	grid(0, 0) = OpCode::IPStart;
+	grid(1, 0) = instruction;
+	grid(2, 0) = OpCode::Terminate;
+	for (int i = 0; i < width; i++)
+	{
+		grid(i, 1) = digits[i];
+	}
+	grid.QueueAddCursor(Cursor(0, 0, 0, 1, width, 1, 0));
+	grid.AddCursors();
+
+	for (int step = 0; step < 10 && update(grid); step++) { }
+
+	writes = grid.Counters().writes;
+	std::string result;
+	for (int i = 0; i < width; i++)
+	{
+		result += static_cast<char>(grid(i, 1));
+	}
+	return result;
+}
+
+static bool WideNumbersAddExactly()
+{
+	struct Case
+	{
+		int instruction;
+		const char* before;
+		const char* after;
+	};
+	// ten or more digits used to overflow an int, and wide enough selections divided by zero
+	static const Case cases[] =
+	{
+		{ OpCode::Increment, "2147483647", "2147483648" },
+		{ OpCode::Increment, "000000000009", "000000000010" },
+		{ OpCode::Increment, "999999999999", "000000000000" },
+		{ OpCode::Increment, "12345678901234567890123456789", "12345678901234567890123456790" },
+		{ OpCode::Decrement, "100000000000", "099999999999" },
+		{ OpCode::Decrement, "000000000000", "000000000000" },
+		{ OpCode::Decrement, "0", "0" },
+		{ OpCode::Increment, "9", "0" },
+		{ OpCode::Increment, "12a", "12a" },
+	};
+
+	bool passed = true;
+	for (const Case& test : cases)
+	{
+		uint64_t writes = 0;
+		const std::string reference = AddOnce(ReferenceEngine::Update, test.instruction, test.before, writes);
+		if (reference != test.after)
+		{
+			std::cout << "  reference gave " << reference << " for " << test.before << " " << static_cast<char>(test.instruction) << std::endl;
+			passed = false;
+		}
+
+		for (size_t i = 0; i < engineCount; i++)
+		{
+			const std::string result = AddOnce(engines[i].update, test.instruction, test.before, writes);
+			// every digit is written, even when zero minus one leaves them unchanged. nothing is written if it is not a number
+			const uint64_t expectedWrites = std::strchr(test.before, 'a') ? 0 : std::strlen(test.before);
+			if (result != test.after || writes != expectedWrites)
+			{
+				std::cout << "  " << engines[i].name << " gave " << result << " with " << writes << " writes for " << test.before << " " <<
+					static_cast<char>(test.instruction) << std::endl;
+				passed = false;
+			}
+		}
+	}
+	return passed;
+}
+
+static bool SelectionsWiderThanGrid()
+{
+	bool passed = true;
+	const int sizes[][2] = { { 12, 6 }, { 16, 8 } };
+	for (const auto& size : sizes)
+	{
+		for (uint32_t seed = 1; seed <= 100; seed++)
+		{
+			Grid program = GenerateProgram(size[0], size[1], seed);
+			int ipX = -1, ipY = -1, selX = -1, selY = -1;
+			for (int y = 0; y < size[1]; y++)
+			{
+				for (int x = 0; x < size[0]; x++)
+				{
+					if (program(x, y) == OpCode::IPStart) { ipX = x; ipY = y; }
+					if (program(x, y) == OpCode::SelectionStart) { selX = x; selY = y; }
+				}
+			}
+			if (ipX < 0 || selX < 0) { continue; }
+
+			// wrapping more than once around a row used to read past the end of it
+			program.QueueAddCursor(Cursor(ipX, ipY, selX, selY, 3 * size[0] + 1, 1, 0));
+			program.AddCursors();
+			for (GridLayout layout : { GridLayout::RowMajor, GridLayout::Blocked })
+			{
+				program.SetLayout(layout);
+				for (size_t i = 0; i < engineCount; i++)
+				{
+					Divergence divergence = RunDifferential(program, engines[i].update, 200);
+					if (divergence.kind != Divergence::None)
+					{
+						std::cout << "  " << engines[i].name << " diverged on " << size[0] << "x" << size[1] << " seed " << seed <<
+							" at step " << divergence.step << std::endl;
+						passed = false;
+					}
+				}
+			}
+		}
+	}
+	return passed;
+}
+
+// run a straight program with a breakpoint on one cell, and return the step it stopped in, or -1 if it never did
+static int BreakAt(int x)
+{
+	Grid grid(9, 2);
+	grid(0, 0) = OpCode::IPStart;
+	grid(1, 0) = OpCode::RightIndicator;
+	grid(2, 0) = OpCode::Set;
+	grid(3, 0) = 'a';
+	grid(4, 0) = OpCode::Skip;
+	grid(5, 0) = OpCode::Path;
+	grid(6, 0) = OpCode::Path;
+	grid(7, 0) = OpCode::Terminate;
+	grid.QueueAddCursor(Cursor(0, 0, 0, 1, 1, 1, 0));
+	grid.AddCursors();
+
+	Debugger debugger(grid.Width(), grid.Height());
+	debugger.SetBreakpoint(x, 0, true);
+	for (int step = 0; step < 10 && grid.Update(debugger); step++)
+	{
+		grid.AddCursors();
+		if (debugger.Stopped()) { return static_cast<int>(debugger.Stop().step); }
+	}
+	return debugger.Stopped() ? static_cast<int>(debugger.Stop().step) : -1;
+}
+
+static bool BreakpointsFireWhereInstructionsRun()
+{
+	// the indicated Set runs in step 1, with the indicator. no cursor ever starts a step on it, so it used to never stop
+	return Expect(BreakAt(2) == 1, "breakpoint on an indicated instruction did not stop") &
+		Expect(BreakAt(5) == -1, "breakpoint on a skipped cell stopped") &
+		Expect(BreakAt(6) == 3, "breakpoint on the cell after a skip did not stop");
+}
+
+static bool CheckpointsRefuseBadDirections()
+{
+	Grid grid(8, 4);
+	grid.QueueAddCursor(Cursor(1, 1, 2, 2, 3, 1, 0));
+	grid.AddCursors();
+	CheckpointData data;
+	Checkpoint::Capture(grid, data);
+
+	Grid restored(1, 1);
+	bool passed = Expect(Checkpoint::Restore(data, restored), "a valid checkpoint was refused");
+
+	// each of these used to be restored, and moving by it overflows or wraps wrongly
+	const int directions[][2] = { { INT_MAX, 0 }, { 8, 0 }, { 1, 1 }, { 0, 0 }, { 0, -2 } };
+	for (const auto& direction : directions)
+	{
+		data.cursors[0] = Cursor(1, 1, 2, 2, 3, direction[0], direction[1]);
+		if (!Checkpoint::Restore(data, restored)) { continue; }
+		std::cout << "  direction " << direction[0] << ", " << direction[1] << " was restored" << std::endl;
+		passed = false;
+	}
+	return passed;
+}
+
+// replay a trace, and return the steps applied followed by the three digits the program increments
+static std::string ReplayTrace(const std::string& path, uint64_t steps)
+{
+	TraceReader reader(path);
+	Grid grid(1, 1);
+	const uint64_t applied = reader.Replay(steps, grid);
+	if (grid.Width() < 3 || grid.Height() < 2) { return "no grid"; }
+	return std::to_string(applied) + " " + static_cast<char>(grid(0, 1)) + static_cast<char>(grid(1, 1)) + static_cast<char>(grid(2, 1));
+}
+
+static bool ReplayCountsOnlyCompleteSteps()
+{
+	// step 0 starts, steps 1 to 3 each write all three digits, step 4 terminates
+	Grid grid(6, 2);
+	grid(0, 0) = OpCode::IPStart;
+	grid(1, 0) = OpCode::Increment;
+	grid(2, 0) = OpCode::Increment;
+	grid(3, 0) = OpCode::Increment;
+	grid(4, 0) = OpCode::Terminate;
+	grid(0, 1) = '0';
+	grid(1, 1) = '0';
+	grid(2, 1) = '0';
+	grid.QueueAddCursor(Cursor(0, 0, 0, 1, 3, 1, 0));
+	grid.AddCursors();
+	{
+		TraceRecorder recorder("eso2d-selftest.e2dt", grid);
+		while (grid.Update(recorder)) { grid.AddCursors(); }
+		recorder.Flush();
+	}
+
+	std::string trace;
+	{
+		std::ifstream in("eso2d-selftest.e2dt", std::ios_base::binary);
+		trace.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	// the last record torn, as by a crash mid-write. its step used to be counted
+	{
+		std::ofstream out("eso2d-selftest.e2dt", std::ios_base::binary | std::ios_base::trunc);
+		out.write(trace.data(), trace.size() - 1);
+	}
+	const std::string torn = ReplayTrace("eso2d-selftest.e2dt", 100);
+	{
+		std::ofstream out("eso2d-selftest.e2dt", std::ios_base::binary | std::ios_base::trunc);
+		out.write(trace.data(), trace.size());
+	}
+
+	const bool passed = Expect(ReplayTrace("eso2d-selftest.e2dt", 100) == "5 003", "whole trace was not replayed") &
+		Expect(ReplayTrace("eso2d-selftest.e2dt", 2) == "2 001", "replay did not stop at the step asked for") &
+		Expect(torn == "4 003", "a step cut short by a torn record was counted");
+	std::remove("eso2d-selftest.e2dt");
+	return passed;
+}
+
+static bool ReadGridRefusesOversizedHeader()
+{
+	Grid grid(1, 1);
+	std::istringstream oversized("200000\n200000\n");
+	std::istringstream negative("-5\n3\n0\n");
+	std::istringstream exact("1\n2\n48\n49");
+	return Expect(!ReadGrid(oversized, grid), "200000 by 200000 header with no cells was read") &
+		Expect(!ReadGrid(negative, grid), "negative width was read") &
+		Expect(ReadGrid(exact, grid) && grid.Width() == 1 && grid.Height() == 2 && grid(0, 1) == 49, "smallest complete grid was not read");
+}
+
+static bool JournalDiscardsItsFiles()
+{
+	Grid grid(4, 4);
+	Journal journal("eso2d-selftest.e2d", "eso2d-selftest.e2dj");
+	journal.Load(grid);
+	grid(1, 2) = 'a';
+	journal.Record(grid, 1, 2);
+	journal.Compact(grid);
+	grid(2, 1) = 'b';
+	journal.Record(grid, 2, 1);
+
+	// the console discards the text autosave once it is migrated, so it can never be loaded over newer edits
+	bool passed = Expect(journal.Discard(), "discard failed");
+	passed &= Expect(!std::ifstream("eso2d-selftest.e2d") && !std::ifstream("eso2d-selftest.e2dj"), "discard left a file behind");
+
+	Grid reloaded(4, 4);
+	Journal fresh("eso2d-selftest.e2d", "eso2d-selftest.e2dj");
+	passed &= Expect(fresh.Load(reloaded) == 0 && reloaded(1, 2) == OpCode::None, "discarded edits were loaded again");
+	return Expect(fresh.Discard(), "discarding nothing failed") && passed;
+}
+
+static bool PublishedStateMatchesGrid()
+{
+	bool passed = true;
+	for (GridLayout layout : { GridLayout::RowMajor, GridLayout::Blocked })
+	{
+		// not a whole number of blocks, so blocked cells are padded
+		Grid grid(10, 7, layout);
+		grid(0, 0) = OpCode::IPStart;
+		grid(1, 0) = OpCode::Increment;
+		grid(2, 0) = OpCode::Terminate;
+		grid(3, 5) = '0';
+		grid(4, 5) = '1';
+		grid(5, 5) = '2';
+		grid(6, 5) = '9';
+		grid.QueueAddCursor(Cursor(0, 0, 3, 5, 4, 1, 0));
+		grid.AddCursors();
+		engines[0].update(grid);
+		engines[0].update(grid);
+
+		StatePublisher publisher;
+		StateReader reader;
+		StateSnapshot snapshot;
+		if (!Expect(publisher.Open("eso2d-selftest", grid) && reader.Attach("eso2d-selftest") && reader.Read(snapshot), "cannot share state"))
+		{
+			passed = false;
+			continue;
+		}
+
+		bool same = snapshot.width == grid.Width() && snapshot.height == grid.Height() &&
+			snapshot.cells.size() == size_t(grid.Width()) * size_t(grid.Height());
+		for (int j = 0; same && j < grid.Height(); j++)
+		{
+			for (int i = 0; i < grid.Width(); i++)
+			{
+				same &= snapshot.cells[i + j * grid.Width()] == grid(i, j);
+			}
+		}
+		passed &= Expect(same, layout == GridLayout::Blocked ? "blocked cells were published out of place" : "cells were published out of place");
+		// writes used to be published as zero
+		passed &= Expect(grid.Counters().writes == 4 && snapshot.counters.writes == grid.Counters().writes, "writes were not published");
+	}
+	return passed;
+}
+
+static bool ServerRefusesOversizedProgram()
+{
+	TestServer server;
+
+	// a 14-byte program claiming 200000 by 200000 cells used to throw bad_alloc and end the server
+	bool passed = Expect(server.Submit("200000\n200000\n", 100) == "error cannot read grid", "oversized program was not refused");
+
+	Grid program(2, 1);
+	program(0, 0) = OpCode::IPStart;
+	program(1, 0) = OpCode::SelectionStart;
+	passed &= Expect(server.Submit(ProgramText(program), 100).compare(0, 14, "program loaded") == 0, "server stopped serving after the oversized program");
+
+	return Expect(server.Stop(), "server did not stop cleanly") && passed;
+}
+
+static bool ServerCancelsJobOfDisconnectedClient()
+{
+	TestServer server;
+
+	// with no limits and no progress lines, the only way the job can end is by noticing its client left
+	{
+		LocalSocket client;
+		server.Submit(ProgramText(EndlessProgram()), 0, client);
+	}
+
+	// the one worker must be free again to take this job
+	LocalSocket second;
+	const std::string reply = server.Submit(ProgramText(EndlessProgram()), 1000, second);
+	std::string done;
+	const bool passed = Expect(reply == "program cached" && second.ReceiveLine(done) && done.compare(0, 5, "done ") == 0,
+		"the job of a disconnected client kept its worker");
+
+	return Expect(server.Stop(), "server did not stop cleanly") && passed;
+}
+
+static const SelfTest tests[] =
+{
+	{ "wide numbers add exactly", WideNumbersAddExactly },
+	{ "selections wider than the grid", SelectionsWiderThanGrid },
+	{ "breakpoints fire where instructions run", BreakpointsFireWhereInstructionsRun },
+	{ "checkpoints refuse bad directions", CheckpointsRefuseBadDirections },
+	{ "replay counts only complete steps", ReplayCountsOnlyCompleteSteps },
+	{ "read grid refuses oversized header", ReadGridRefusesOversizedHeader },
+	{ "journal discards its files", JournalDiscardsItsFiles },
+	{ "published state matches the grid", PublishedStateMatchesGrid },
+	{ "server refuses oversized program", ServerRefusesOversizedProgram },
+	{ "server cancels the job of a disconnected client", ServerCancelsJobOfDisconnectedClient },
+};
+
+int SelfTestCommand(int argc, char** argv)
+{
+	const char* filter = argc > 0 ? argv[0] : nullptr;
+	int run = 0;
+	int failures = 0;
+	for (const SelfTest& test : tests)
+	{
+		if (filter && !std::strstr(test.name, filter)) { continue; }
+
+		run++;
+		const bool passed = test.run();
+		if (!passed) { failures++; }
+		std::cout << (passed ? "pass  " : "FAIL  ") << test.name << std::endl;
+	}
+
+	std::cout << run << " tests, " << failures << " failed" << std::endl;
+	return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,493 @@
+#include "commands.h"
+#include "engines.h"
+#include "local_socket.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <memory>
+#include <new>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void Interrupt(int)
+{
+	interrupted = 1;
+}
+
+// longest a client may go quiet while the server waits for its request or program
+static const int clientIdleMilliseconds = 10000;
+
+// largest program accepted, in bytes of text
+static const uint64_t maxProgramBytes = uint64_t(1) << 28;
+// a program is received this much at a time, so a client only makes the server allocate what it has actually sent
+static const size_t programChunkBytes = size_t(1) << 20;
+
+/// <summary>
+/// Programs already loaded, laid out and given their start cursor, keyed by content hash, size and layout.
+/// The hash is SHA-256, so a client cannot choose a program that takes the place of another one.
+/// A job copies its program out of the cache, so a repeated program costs one copy rather than a load.
+/// The least recently used program is dropped once the cache is full.
+/// </summary>
+class ProgramCache
+{
+public:
+	explicit ProgramCache(size_t capacity) : capacity(capacity) { }
+
+	std::shared_ptr<const Grid> Find(const std::string& hash, uint64_t size, GridLayout layout)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto it = entries.begin(); it != entries.end(); ++it)
+		{
+			if (it->hash == hash && it->size == size && it->layout == layout)
+			{
+				entries.splice(entries.begin(), entries, it);
+				return it->program;
+			}
+		}
+		return nullptr;
+	}
+
+	// two jobs missing on the same program at once both load it, and the later insert wins
+	void Insert(const std::string& hash, uint64_t size, GridLayout layout, std::shared_ptr<const Grid> program)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto it = entries.begin(); it != entries.end(); ++it)
+		{
+			if (it->hash == hash && it->size == size && it->layout == layout)
+			{
+				entries.erase(it);
+				break;
+			}
+		}
+		entries.push_front(Entry { hash, size, layout, std::move(program) });
+		while (entries.size() > capacity) { entries.pop_back(); }
+	}
+
+private:
+	struct Entry
+	{
+		std::string hash;
+		uint64_t size;
+		GridLayout layout;
+		std::shared_ptr<const Grid> program;
+	};
+
+	std::mutex mutex;
+	// most recently used first
+	std::list<Entry> entries;
+	size_t capacity;
+};
+
+/// <summary>
+/// Connections accepted but not yet picked up by a worker.
+/// </summary>
+class ConnectionQueue
+{
+public:
+	ConnectionQueue() : closed(false) { }
+
+	void Push(LocalSocket connection)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			connections.push_back(std::move(connection));
+		}
+		ready.notify_one();
+	}
+
+	// false once the queue is closed and empty
+	bool Pop(LocalSocket& connection)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		ready.wait(lock, [this] { return closed || !connections.empty(); });
+		if (connections.empty()) { return false; }
+		connection = std::move(connections.front());
+		connections.pop_front();
+		return true;
+	}
+
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		ready.notify_all();
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<LocalSocket> connections;
+	bool closed;
+};
+
+struct Patch
+{
+	int x;
+	int y;
+	int value;
+};
+
+// a limit from the request, kept under the server's own limit. zero means none
+template <typename T>
+static T Cap(T requested, T ceiling)
+{
+	if (ceiling == T()) { return requested; }
+	if (requested == T()) { return ceiling; }
+	return requested < ceiling ? requested : ceiling;
+}
+
+struct Server
+{
+	ProgramCache cache;
+	// applied to every job, on top of the job's own limits
+	GridLimits ceiling;
+	std::atomic<bool> stopping;
+
+	Server(size_t cacheSize, const GridLimits& ceiling) : cache(cacheSize), ceiling(ceiling), stopping(false) { }
+};
+
+// true if text is a hash from ContentHash
+static bool IsContentHash(const std::string& text)
+{
+	if (text.size() != 64) { return false; }
+	for (char c : text)
+	{
+		if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) { return false; }
+	}
+	return true;
+}
+
+static bool Fail(LocalSocket& client, const std::string& message)
+{
+	client.SendLine("error " + message);
+	return false;
+}
+
+// find the program in the cache, or ask the client for it and load it. null after replying with an error
+static std::shared_ptr<const Grid> FindProgram(Server& server, LocalSocket& client, const std::string& hash, uint64_t size, GridLayout layout)
+{
+	std::shared_ptr<const Grid> program = server.cache.Find(hash, size, layout);
+	if (program)
+	{
+		client.SendLine("program cached");
+		return program;
+	}
+
+	if (!client.SendLine("send")) { return nullptr; }
+	std::string text;
+	while (text.size() < size)
+	{
+		const size_t received = text.size();
+		const size_t chunk = size - received < programChunkBytes ? static_cast<size_t>(size - received) : programChunkBytes;
+		text.resize(received + chunk);
+		if (!client.Receive(&text[received], chunk)) { return nullptr; }
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	// the hash names the program for every later client, so it must match what was sent
+	if (ContentHash(text.data(), text.size()) != hash)
+	{
+		Fail(client, "program does not match its hash");
+		return nullptr;
+	}
+
+	std::shared_ptr<Grid> loaded = std::make_shared<Grid>(1, 1, layout);
+	std::istringstream in(text);
+	if (!ReadGrid(in, *loaded))
+	{
+		Fail(client, "cannot read grid");
+		return nullptr;
+	}
+	if (!loaded->QueueStartCursor())
+	{
+		Fail(client, "program has no start cursor");
+		return nullptr;
+	}
+	loaded->AddCursors();
+
+	const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	server.cache.Insert(hash, size, layout, loaded);
+	client.SendLine("program loaded " + std::to_string(microseconds));
+	return loaded;
+}
+
+static std::string ProgressLine(const Grid& grid)
+{
+	const GridCounters& counters = grid.Counters();
+	return "progress " + std::to_string(counters.steps) + " " + std::to_string(counters.writes) + " " +
+		std::to_string(grid.Cursors().size());
+}
+
+// read one request, run it and stream the results. false if the client went away or the request was bad
+static bool HandleJob(Server& server, LocalSocket& client)
+{
+	std::string line;
+	if (!client.ReceiveLine(line) || line != "eso2d 1") { return Fail(client, "expected eso2d 1"); }
+
+	std::string hash;
+	uint64_t size = 0;
+	bool haveProgram = false;
+	GridLayout layout = GridLayout::RowMajor;
+	const Engine* engine = &engines[0];
+	GridLimits limits = GridLimits();
+	long progressInterval = 0;
+	bool sendGrid = false;
+	std::vector<Patch> patches;
+
+	for (;;)
+	{
+		if (!client.ReceiveLine(line)) { return false; }
+
+		std::istringstream words(line);
+		std::string word;
+		words >> word;
+		if (word == "run") { break; }
+
+		if (word == "program")
+		{
+			words >> hash >> size;
+			if (!words || !IsContentHash(hash) || size == 0 || size > maxProgramBytes) { return Fail(client, "bad program line"); }
+			haveProgram = true;
+		}
+		else if (word == "layout")
+		{
+			words >> word;
+			if (word == "row") { layout = GridLayout::RowMajor; }
+			else if (word == "blocked") { layout = GridLayout::Blocked; }
+			else { return Fail(client, "unknown layout " + word); }
+		}
+		else if (word == "engine")
+		{
+			words >> word;
+			engine = nullptr;
+			for (size_t i = 0; i < engineCount; i++)
+			{
+				if (word == engines[i].name) { engine = &engines[i]; }
+			}
+			if (!engine) { return Fail(client, "unknown engine " + word); }
+		}
+		else if (word == "limits")
+		{
+			unsigned long long maxSteps, maxCursors, maxWrites, timeLimit;
+			words >> maxSteps >> maxCursors >> maxWrites >> timeLimit;
+			if (!words) { return Fail(client, "bad limits line"); }
+			limits.maxSteps = maxSteps;
+			limits.maxCursors = static_cast<size_t>(maxCursors);
+			limits.maxWrites = maxWrites;
+			limits.timeLimit = std::chrono::milliseconds(timeLimit);
+		}
+		else if (word == "progress")
+		{
+			words >> progressInterval;
+			if (!words || progressInterval < 0) { return Fail(client, "bad progress line"); }
+		}
+		else if (word == "patch")
+		{
+			Patch patch;
+			words >> patch.x >> patch.y >> patch.value;
+			if (!words) { return Fail(client, "bad patch line"); }
+			patches.push_back(patch);
+		}
+		else if (word == "output")
+		{
+			sendGrid = true;
+		}
+		else
+		{
+			return Fail(client, "unknown request " + word);
+		}
+	}
+	if (!haveProgram) { return Fail(client, "no program"); }
+
+	std::shared_ptr<const Grid> program = FindProgram(server, client, hash, size, layout);
+	if (!program) { return false; }
+
+	Grid grid(*program);
+	for (const Patch& patch : patches)
+	{
+		if (patch.x < 0 || patch.x >= grid.Width() || patch.y < 0 || patch.y >= grid.Height())
+		{
+			return Fail(client, "patch outside the grid");
+		}
+		grid(patch.x, patch.y) = patch.value;
+	}
+
+	limits.maxSteps = Cap(limits.maxSteps, server.ceiling.maxSteps);
+	limits.maxCursors = Cap(limits.maxCursors, server.ceiling.maxCursors);
+	limits.maxWrites = Cap(limits.maxWrites, server.ceiling.maxWrites);
+	limits.timeLimit = Cap(limits.timeLimit, server.ceiling.timeLimit);
+	grid.SetLimits(limits);
+
+	const auto start = std::chrono::steady_clock::now();
+	const std::chrono::milliseconds interval(progressInterval);
+	auto nextProgress = start + interval;
+	// like the time limit, read the clock every few thousand instructions rather than every step
+	uint64_t nextCheck = 1 << 14;
+
+	bool alive = grid.Status() == GridStatus::Running;
+	while (alive)
+	{
+		alive = engine->update(grid);
+		grid.AddCursors();
+
+		const GridCounters& counters = grid.Counters();
+		if (counters.executions + counters.steps >= nextCheck)
+		{
+			nextCheck = counters.executions + counters.steps + (1 << 14);
+			if (server.stopping) { return Fail(client, "server stopping"); }
+			// a client that disconnects cancels its job, so a program that never ends cannot keep the worker after its client is gone
+			if (client.PeerClosed()) { return false; }
+
+			const auto now = std::chrono::steady_clock::now();
+			if (progressInterval > 0 && now >= nextProgress)
+			{
+				if (!client.SendLine(ProgressLine(grid))) { return false; }
+				nextProgress = now + interval;
+			}
+		}
+	}
+
+	const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	const GridCounters& counters = grid.Counters();
+	if (!client.SendLine("done " + std::to_string(counters.steps) + " " + std::to_string(counters.writes) + " " +
+		std::to_string(grid.Cursors().size()) + " " + std::to_string(grid.QueuedCursors().size()) + " " +
+		std::to_string(microseconds) + " " + StatusName(grid.Status())))
+	{
+		return false;
+	}
+
+	if (sendGrid)
+	{
+		std::ostringstream out;
+		out << grid;
+		const std::string text = out.str();
+		if (!client.SendLine("grid " + std::to_string(text.size())) || !client.Send(text.data(), text.size())) { return false; }
+	}
+	return true;
+}
+
+static void Work(Server& server, ConnectionQueue& queue)
+{
+	LocalSocket client;
+	while (queue.Pop(client))
+	{
+		// an idle client would otherwise hold this worker, and keep the server from stopping, forever
+		client.SetReceiveTimeout(clientIdleMilliseconds, &server.stopping);
+		if (server.stopping)
+		{
+			Fail(client, "server stopping");
+		}
+		else
+		{
+			// a job that runs out of memory, say by splitting cursors without a limit, fails alone rather than taking the server down
+			try
+			{
+				HandleJob(server, client);
+			}
+			catch (const std::bad_alloc&)
+			{
+				Fail(client, "out of memory");
+			}
+		}
+		client.Close();
+	}
+}
+
+int ServeCommand(int argc, char** argv)
+{
+	if (argc < 1)
+	{
+		std::cerr << "usage: eso2d-tools serve <socket> [--workers n] [--cache n] [--max-steps n] [--max-cursors n] [--max-writes n] [--time-limit-ms n]" << std::endl;
+		return 1;
+	}
+
+	unsigned int workers = std::thread::hardware_concurrency();
+	size_t cacheSize = 64;
+	GridLimits ceiling = GridLimits();
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+		{
+			workers = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+		{
+			cacheSize = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc)
+		{
+			ceiling.maxSteps = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-cursors") == 0 && i + 1 < argc)
+		{
+			ceiling.maxCursors = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-writes") == 0 && i + 1 < argc)
+		{
+			ceiling.maxWrites = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--time-limit-ms") == 0 && i + 1 < argc)
+		{
+			ceiling.timeLimit = std::chrono::milliseconds(std::strtoull(argv[++i], nullptr, 10));
+		}
+	}
+	if (workers < 1) { workers = 1; }
+	if (cacheSize < 1) { cacheSize = 1; }
+
+	LocalSocket listener;
+	if (!listener.Listen(argv[0]))
+	{
+		std::cerr << "cannot listen on " << argv[0] << std::endl;
+		return 1;
+	}
+
+	interrupted = 0;
+	std::signal(SIGINT, Interrupt);
+#ifdef SIGPIPE
+	std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+	Server server(cacheSize, ceiling);
+	ConnectionQueue queue;
+	std::vector<std::thread> threads;
+	for (unsigned int i = 0; i < workers; i++)
+	{
+		threads.emplace_back(Work, std::ref(server), std::ref(queue));
+	}
+	std::cerr << "serving on " << argv[0] << " with " << workers << " workers" << std::endl;
+
+	while (!interrupted)
+	{
+		LocalSocket client;
+		if (listener.Accept(client, 200))
+		{
+			queue.Push(std::move(client));
+		}
+	}
+
+	// running jobs see stopping at their next clock check, jobs waiting on their client give up, and queued ones are refused
+	server.stopping = true;
+	queue.Close();
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	listener.Close();
+
+	std::signal(SIGINT, SIG_DFL);
+	return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Hash bytes with SHA-256 (FIPS 180-4).
+/// </summary>
+/// <param name="data">Bytes to hash.</param>
+/// <param name="size">Number of bytes.</param>
+/// <param name="digest">Set to the 32-byte digest.</param>
+void Sha256(const void* data, size_t size, uint8_t digest[32]);
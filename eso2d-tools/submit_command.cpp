@@ -0,0 +1,175 @@
+#include "commands.h"
+#include "local_socket.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+int SubmitCommand(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: eso2d-tools submit <socket> <program.e2d> [--engine name] [--layout row|blocked] [--patch x y value]... [--max-steps n] [--max-cursors n] [--max-writes n] [--time-limit-ms n] [--progress-ms n] [--out result.e2d]" << std::endl;
+		return 1;
+	}
+
+	// the request is built up front, so a bad option fails before connecting
+	std::ostringstream request;
+	request << "eso2d 1\n";
+	GridLayout layout = GridLayout::RowMajor;
+	unsigned long long maxSteps = 0;
+	unsigned long long maxCursors = 0;
+	unsigned long long maxWrites = 0;
+	unsigned long long timeLimit = 0;
+	const char* outPath = nullptr;
+	for (int i = 2; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc)
+		{
+			request << "engine " << argv[++i] << "\n";
+		}
+		else if (std::strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+		{
+			if (!ParseLayout(argv[++i], layout)) { return 1; }
+		}
+		else if (std::strcmp(argv[i], "--patch") == 0 && i + 3 < argc)
+		{
+			request << "patch " << std::atoi(argv[i + 1]) << " " << std::atoi(argv[i + 2]) << " " << std::atoi(argv[i + 3]) << "\n";
+			i += 3;
+		}
+		else if (std::strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc)
+		{
+			maxSteps = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-cursors") == 0 && i + 1 < argc)
+		{
+			maxCursors = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--max-writes") == 0 && i + 1 < argc)
+		{
+			maxWrites = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--time-limit-ms") == 0 && i + 1 < argc)
+		{
+			timeLimit = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--progress-ms") == 0 && i + 1 < argc)
+		{
+			request << "progress " << std::atol(argv[++i]) << "\n";
+		}
+		else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+		{
+			outPath = argv[++i];
+			request << "output\n";
+		}
+	}
+	request << "layout " << (layout == GridLayout::Blocked ? "blocked" : "row") << "\n";
+	request << "limits " << maxSteps << " " << maxCursors << " " << maxWrites << " " << timeLimit << "\n";
+
+	// the program is sent as text, exactly as saved, so the server's hash matches
+	std::ifstream file(argv[1], std::ios_base::binary);
+	if (!file)
+	{
+		std::cerr << "cannot open " << argv[1] << std::endl;
+		return 1;
+	}
+	const std::string program((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (program.empty())
+	{
+		std::cerr << "cannot read grid from " << argv[1] << std::endl;
+		return 1;
+	}
+
+	request << "program " << ContentHash(program.data(), program.size()) << " " << program.size() << "\n";
+	request << "run\n";
+
+	LocalSocket server;
+	if (!server.Connect(argv[0]))
+	{
+		std::cerr << "nothing is serving on " << argv[0] << std::endl;
+		return 1;
+	}
+	const std::string text = request.str();
+	if (!server.Send(text.data(), text.size()))
+	{
+		std::cerr << "lost connection to " << argv[0] << std::endl;
+		return 1;
+	}
+
+	std::string line;
+	while (server.ReceiveLine(line))
+	{
+		std::istringstream words(line);
+		std::string word;
+		words >> word;
+
+		if (word == "send")
+		{
+			// the server has not seen this program yet
+			if (!server.Send(program.data(), program.size())) { break; }
+		}
+		else if (word == "program")
+		{
+			words >> word;
+			if (word == "loaded")
+			{
+				unsigned long long microseconds = 0;
+				words >> microseconds;
+				std::cerr << "program loaded in " << microseconds / 1000.0 << " ms" << std::endl;
+			}
+			else
+			{
+				std::cerr << "program cached" << std::endl;
+			}
+		}
+		else if (word == "progress")
+		{
+			unsigned long long steps = 0, writes = 0, cursors = 0;
+			words >> steps >> writes >> cursors;
+			std::cerr << steps << " steps, " << writes << " writes, " << cursors << " cursors alive" << std::endl;
+		}
+		else if (word == "done")
+		{
+			unsigned long long steps = 0, writes = 0, cursors = 0, queued = 0, microseconds = 0;
+			std::string status;
+			words >> steps >> writes >> cursors >> queued >> microseconds;
+			std::getline(words >> std::ws, status);
+
+			std::cout << steps << " steps, " << writes << " writes, " << cursors << " cursors alive";
+			if (queued > 0)
+			{
+				std::cout << ", " << queued << " queued";
+			}
+			std::cout << ", " << status << " in " << microseconds / 1000.0 << " ms" << std::endl;
+			if (!outPath) { return 0; }
+		}
+		else if (word == "grid")
+		{
+			unsigned long long size = 0;
+			words >> size;
+			std::string result(static_cast<size_t>(size), '\0');
+			if (!server.Receive(&result[0], result.size())) { break; }
+
+			std::ofstream out(outPath, std::ios_base::binary);
+			if (!out.write(result.data(), result.size()))
+			{
+				std::cerr << "cannot write " << outPath << std::endl;
+				return 1;
+			}
+			return 0;
+		}
+		else if (word == "error")
+		{
+			std::string message;
+			std::getline(words >> std::ws, message);
+			std::cerr << "server: " << message << std::endl;
+			return 1;
+		}
+	}
+
+	std::cerr << "lost connection to " << argv[0] << std::endl;
+	return 1;
+}
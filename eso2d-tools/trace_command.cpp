@@ -0,0 +1,140 @@
+#include "commands.h"
+#include "trace.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+int RecordCommand(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: eso2d-tools record <program.e2d> <trace.e2dt> [max steps]" << std::endl;
+		return 1;
+	}
+
+	Grid grid(1, 1);
+	if (!LoadGrid(argv[0], grid)) { return 1; }
+
+	const unsigned long long maxSteps = argc >= 3 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+
+	if (!grid.QueueStartCursor())
+	{
+		std::cerr << "program has no '" << char(OpCode::IPStart) << "' or '" << char(OpCode::SelectionStart) << "'" << std::endl;
+		return 1;
+	}
+	grid.AddCursors();
+
+	TraceRecorder recorder(argv[1], grid);
+	if (!recorder.IsOpen())
+	{
+		std::cerr << "cannot write " << argv[1] << std::endl;
+		return 1;
+	}
+
+	unsigned long long steps = 0;
+	while (steps < maxSteps)
+	{
+		steps++;
+		if (!grid.Update(recorder)) { break; }
+		grid.AddCursors();
+	}
+	recorder.Flush();
+
+	std::cout << "recorded " << steps << " steps" << std::endl;
+	return 0;
+}
+
+static int Summarize(TraceReader& reader)
+{
+	unsigned long long steps = 0;
+	unsigned long long executes = 0;
+	unsigned long long writes = 0;
+	unsigned long long cursorsThisStep = 0;
+	unsigned long long maxCursors = 0;
+	// the last execute was a side indicator, so the next one is the same cursor running the indicated instruction
+	bool indicated = false;
+	std::map<int, unsigned long long> instructions;
+
+	TraceEvent event;
+	while (reader.Next(event))
+	{
+		switch (event.tag)
+		{
+		case Trace::Step:
+			steps++;
+			cursorsThisStep = 0;
+			break;
+
+		case Trace::Execute:
+			executes++;
+			instructions[event.instruction]++;
+			if (!indicated && ++cursorsThisStep > maxCursors) { maxCursors = cursorsThisStep; }
+			indicated = !indicated && (event.instruction == OpCode::LeftIndicator || event.instruction == OpCode::RightIndicator);
+			break;
+
+		case Trace::Write:
+			writes++;
+			break;
+		}
+	}
+
+	std::cout << "grid:         " << reader.Width() << "x" << reader.Height() << std::endl;
+	std::cout << "steps:        " << steps << std::endl;
+	std::cout << "executions:   " << executes << std::endl;
+	std::cout << "cell writes:  " << writes << std::endl;
+	std::cout << "max cursors:  " << maxCursors << std::endl;
+	std::cout << "instructions:" << std::endl;
+	for (const auto& entry : instructions)
+	{
+		if (entry.first >= ' ' && entry.first < 127)
+		{
+			std::cout << "  '" << char(entry.first) << "'  " << entry.second << std::endl;
+		}
+		else
+		{
+			std::cout << "  " << entry.first << "  " << entry.second << std::endl;
+		}
+	}
+	return 0;
+}
+
+int TraceCommand(int argc, char** argv)
+{
+	if (argc < 1)
+	{
+		std::cerr << "usage: eso2d-tools trace <trace.e2dt> [step <n> [out.e2d]]" << std::endl;
+		return 1;
+	}
+
+	TraceReader reader(argv[0]);
+	if (!reader.IsOpen())
+	{
+		std::cerr << "cannot read trace " << argv[0] << std::endl;
+		return 1;
+	}
+
+	if (argc < 3 || std::strcmp(argv[1], "step") != 0)
+	{
+		return Summarize(reader);
+	}
+
+	const unsigned long long step = std::strtoull(argv[2], nullptr, 10);
+	Grid grid(1, 1);
+	unsigned long long applied = reader.Replay(step, grid);
+	if (applied < step)
+	{
+		std::cerr << "trace ends after step " << applied << std::endl;
+	}
+
+	if (argc >= 4)
+	{
+		std::ofstream out(argv[3], std::ios_base::binary);
+		out << grid;
+	}
+	else
+	{
+		std::cout << grid;
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include "commands.h"
+#include "ansi_terminal.h"
+#include "shared_state.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void Interrupt(int)
+{
+	interrupted = 1;
+}
+
+int ViewCommand(int argc, char** argv)
+{
+	if (argc < 1)
+	{
+		std::cerr << "usage: eso2d-tools view <name> [--fps n]" << std::endl;
+		return 1;
+	}
+
+	int fps = 10;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+		{
+			fps = std::atoi(argv[++i]);
+		}
+	}
+	if (fps < 1) { fps = 1; }
+
+	StateReader reader;
+	if (!reader.Attach(argv[0]))
+	{
+		std::cerr << "nothing is published as " << argv[0] << std::endl;
+		return 1;
+	}
+
+	StateSnapshot snapshot;
+	if (!reader.Read(snapshot))
+	{
+		std::cerr << "cannot read the state published as " << argv[0] << std::endl;
+		return 1;
+	}
+
+	std::signal(SIGINT, Interrupt);
+
+	AnsiTerminal& terminal = Terminal();
+	// one extra row for the status line, wide enough to fit it
+	terminal.Open(std::max(snapshot.width, 64), snapshot.height + 1);
+
+	const auto frameTime = std::chrono::microseconds(1000000 / fps);
+	auto nextFrame = std::chrono::steady_clock::now();
+
+	// the viewer's own grid, so drawing is the same as for a local run
+	Grid grid(snapshot.width, snapshot.height);
+	uint64_t lastPublishes = 0;
+	while (!interrupted)
+	{
+		const bool fresh = reader.Read(snapshot);
+		if (fresh)
+		{
+			for (int j = 0; j < snapshot.height; j++)
+			{
+				for (int i = 0; i < snapshot.width; i++)
+				{
+					grid(i, j) = snapshot.cells[i + j * snapshot.width];
+				}
+			}
+			grid.Stop();
+			for (const Cursor& cursor : snapshot.cursors)
+			{
+				grid.QueueAddCursor(cursor);
+			}
+			grid.AddCursors();
+		}
+
+		std::string status =
+			"step " + std::to_string(snapshot.counters.steps) +
+			"  cursors " + std::to_string(snapshot.liveCursors);
+		if (snapshot.liveCursors > snapshot.cursors.size())
+		{
+			status += " (" + std::to_string(snapshot.cursors.size()) + " shown)";
+		}
+		if (!snapshot.open)
+		{
+			status += "  finished";
+		}
+		else if (!fresh || snapshot.publishes == lastPublishes)
+		{
+			status += "  waiting";
+		}
+		lastPublishes = snapshot.publishes;
+
+		terminal.Clear();
+		grid.Print();
+		terminal.SetLayer(2);
+		terminal.SetColor(MakeColor(0x99, 0x99, 0x99, 0xFF));
+		terminal.Print(0, grid.Height(), status);
+		terminal.Refresh();
+
+		if (!snapshot.open) { break; }
+
+		nextFrame += frameTime;
+		std::this_thread::sleep_until(nextFrame);
+	}
+
+	terminal.Close();
+	std::signal(SIGINT, SIG_DFL);
+	return 0;
+}
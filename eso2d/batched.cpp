@@ -0,0 +1,183 @@
+#include "batched.h"
+
+#include <chrono>
+
+BatchedStepper::BatchedStepper() : pending(0), anyDead(false) { }
+
+BatchedStepper::Group BatchedStepper::Classify(int instruction)
+{
+	// group for each instruction below 128. everything else is not an instruction, so its cursor dies.
+	struct Table
+	{
+		uint8_t groups[128];
+	};
+
+	static const Table table = []
+	{
+		Table table;
+		for (uint8_t& group : table.groups) { group = DeathGroup; }
+
+		table.groups[OpCode::Path] = PathGroup;
+		table.groups[OpCode::IPStart] = PathGroup;
+		table.groups[OpCode::Skip] = SkipGroup;
+		table.groups[OpCode::Left] = LeftGroup;
+		table.groups[OpCode::Right] = RightGroup;
+		table.groups[OpCode::Up] = UpGroup;
+		table.groups[OpCode::Down] = DownGroup;
+		table.groups[OpCode::Widen] = WidenGroup;
+		table.groups[OpCode::Shrink] = ShrinkGroup;
+		table.groups[OpCode::Conditional] = ConditionalGroup;
+		table.groups[OpCode::Split] = SplitGroup;
+
+		table.groups[OpCode::Move] = Serial;
+		table.groups[OpCode::Increment] = Serial;
+		table.groups[OpCode::Decrement] = Serial;
+		table.groups[OpCode::Set] = Serial;
+		table.groups[OpCode::LeftIndicator] = Serial;
+		table.groups[OpCode::RightIndicator] = Serial;
+		return table;
+	}();
+
+	return static_cast<unsigned int>(instruction) < 128 ? static_cast<Group>(table.groups[instruction]) : DeathGroup;
+}
+
+bool BatchedStepper::Update(Grid& grid)
+{
+	if (!grid.BeginStep()) { return false; }
+
+	const bool timed = grid.timing;
+	std::chrono::steady_clock::time_point start;
+	if (timed) { start = std::chrono::steady_clock::now(); }
+
+	std::vector<Cursor>& cursors = grid.cursors;
+	grid.counters.executions += cursors.size();
+
+	dead.assign(cursors.size(), 0);
+	anyDead = false;
+	pending = 0;
+
+	// same order as Grid::Update. nothing batched writes to the grid, so a batch can run in any order,
+	// as long as it has all run before the next cursor that might write.
+	for (int i = cursors.size() - 1; i >= 0; i--)
+	{
+		const Group group = Classify(grid(cursors[i].ip));
+		if (group != Serial)
+		{
+			groups[group].push_back(i);
+			pending++;
+			continue;
+		}
+
+		if (pending > 0) { Flush(grid); }
+		if (!cursors[i].Update(grid))
+		{
+			dead[i] = 1;
+			anyDead = true;
+		}
+	}
+	Flush(grid);
+
+	// remove dead cursors in one pass, keeping the rest in the order erase would have left them
+	if (anyDead)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < cursors.size(); i++)
+		{
+			if (dead[i]) { continue; }
+			if (kept != i) { cursors[kept] = cursors[i]; }
+			kept++;
+		}
+		cursors.erase(cursors.begin() + kept, cursors.end());
+	}
+	const bool withinLimits = grid.EndStep();
+
+	if (timed)
+	{
+		grid.counters.updateNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	return withinLimits && cursors.size() > 0;
+}
+
+void BatchedStepper::Flush(Grid& grid)
+{
+	std::vector<Cursor>& cursors = grid.cursors;
+
+	for (int i : groups[PathGroup])
+	{
+		cursors[i].Move(grid);
+	}
+
+	for (int i : groups[SkipGroup])
+	{
+		Cursor& cursor = cursors[i];
+		cursor.ip.MoveBy(cursor.dx, cursor.dy, grid);
+		cursor.Move(grid);
+	}
+
+	for (int i : groups[LeftGroup])
+	{
+		cursors[i].selected.MoveBy(-1, 0, grid);
+		cursors[i].Move(grid);
+	}
+
+	for (int i : groups[RightGroup])
+	{
+		cursors[i].selected.MoveBy(1, 0, grid);
+		cursors[i].Move(grid);
+	}
+
+	for (int i : groups[UpGroup])
+	{
+		cursors[i].selected.MoveBy(0, -1, grid);
+		cursors[i].Move(grid);
+	}
+
+	for (int i : groups[DownGroup])
+	{
+		cursors[i].selected.MoveBy(0, 1, grid);
+		cursors[i].Move(grid);
+	}
+
+	for (int i : groups[WidenGroup])
+	{
+		cursors[i].selected.Widen(grid);
+		cursors[i].Move(grid);
+	}
+
+	for (int i : groups[ShrinkGroup])
+	{
+		cursors[i].selected.Shrink(grid);
+		cursors[i].Move(grid);
+	}
+
+	for (int i : groups[ConditionalGroup])
+	{
+		cursors[i].Conditional(grid);
+		cursors[i].Move(grid);
+	}
+
+	// children are queued in serial order, so AddCursors adds them in the same order as Grid::Update
+	for (int i : groups[SplitGroup])
+	{
+		Cursor& cursor = cursors[i];
+		Cursor other(cursor);
+		other.TurnLeft();
+		other.Move(grid);
+		cursor.TurnRight();
+		cursor.Move(grid);
+		grid.QueueAddCursor(other);
+	}
+
+	for (int i : groups[DeathGroup])
+	{
+		dead[i] = 1;
+		anyDead = true;
+	}
+
+	for (std::vector<int>& group : groups)
+	{
+		group.clear();
+	}
+	pending = 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "eso2d.h"
+
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Steps a grid by grouping cursors on the instruction under their ip, then running each group through its own loop.
+/// With many cursors this replaces one unpredictable switch per cursor with a few tight loops.
+/// Instructions that can write to the grid ('m', '+', '-', '=', '&lt;', '&gt;') are run serially, in place, and end the current batch,
+/// so every cursor sees exactly the grid it would under Grid::Update and the results are identical.
+/// Keeps its group buffers between steps, so one stepper should be reused for a whole run.
+/// </summary>
+class BatchedStepper
+{
+public:
+	BatchedStepper();
+
+	/// <summary>
+	/// Step every cursor once. Equivalent to Grid::Update, without hooks.
+	/// </summary>
+	/// <param name="grid">Grid to step.</param>
+	/// <returns>True if any cursor is still alive, false otherwise.</returns>
+	bool Update(Grid& grid);
+
+private:
+	enum Group : uint8_t
+	{
+		PathGroup, // '.', '@'
+		SkipGroup,
+		LeftGroup,
+		RightGroup,
+		UpGroup,
+		DownGroup,
+		WidenGroup,
+		ShrinkGroup,
+		ConditionalGroup,
+		SplitGroup,
+		DeathGroup, // '#' and anything that is not an instruction
+		GroupCount,
+		Serial = GroupCount // may write, run in place
+	};
+
+	static Group Classify(int instruction);
+
+	void Flush(Grid& grid);
+
+	// cursor indices for each group, in the order Grid::Update would run them
+	std::vector<int> groups[GroupCount];
+	size_t pending;
+	std::vector<uint8_t> dead;
+	bool anyDead;
+};
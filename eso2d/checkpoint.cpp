@@ -0,0 +1,393 @@
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+// layout of a checkpoint file: this header, then cellCount cells of cellBytes each in memory order,
+// then cursorCount live cursors and queuedCount queued cursors
+struct CheckpointHeader
+{
+	char magic[4];
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	uint32_t layout;
+	// 1 if every cell fits in a byte, as in most programs, 4 otherwise
+	uint32_t cellBytes;
+	uint64_t cellCount;
+	uint64_t cursorCount;
+	uint64_t queuedCount;
+	uint64_t steps;
+	uint64_t executions;
+	uint64_t writes;
+};
+
+struct CheckpointCursor
+{
+	int32_t ipX;
+	int32_t ipY;
+	int32_t ipPreviousX;
+	int32_t ipPreviousY;
+	int32_t selectedX;
+	int32_t selectedY;
+	int32_t selectedPreviousX;
+	int32_t selectedPreviousY;
+	int32_t selectedWidth;
+	int32_t dx;
+	int32_t dy;
+	// wrap flags: ip x, ip y, selection x, selection y from the lowest bit up
+	uint32_t wrapped;
+};
+
+static const char checkpointMagic[4] = { 'E', '2', 'D', 'C' };
+static const uint32_t checkpointVersion = 1;
+
+static_assert(sizeof(int) == sizeof(int32_t), "checkpoints store cells as 32-bit integers");
+
+// cells are converted in chunks this size, rather than all at once
+static const size_t checkpointChunk = 1 << 16;
+
+static bool ReplaceFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+void Checkpoint::Capture(const Grid& grid, CheckpointData& data)
+{
+	data.width = grid.width;
+	data.height = grid.height;
+	data.layout = grid.layout;
+	data.cells.assign(grid.gridData, grid.gridData + grid.Cells());
+	data.cursors = grid.cursors;
+	data.queued = grid.cursorsToAdd;
+	data.counters = grid.counters;
+	data.counters.updateNanoseconds = 0;
+	data.counters.printNanoseconds = 0;
+}
+
+bool Checkpoint::Valid(int width, int height, GridLayout layout)
+{
+	return width > 0 && height > 0 && (layout == GridLayout::RowMajor || layout == GridLayout::Blocked) &&
+		Grid::Cells(width, height, layout) <= uint64_t(INT_MAX);
+}
+
+bool Checkpoint::Valid(const Cursor& cursor, int width, int height)
+{
+	auto inside = [width, height](int x, int y) { return x >= 0 && y >= 0 && x < width && y < height; };
+	return inside(cursor.ip.x, cursor.ip.y) && inside(cursor.ip.prevX, cursor.ip.prevY) &&
+		inside(cursor.selected.x, cursor.selected.y) && inside(cursor.selected.prevX, cursor.selected.prevY) &&
+		cursor.selected.width >= 1 && cursor.selected.width <= width &&
+		((cursor.dx == 0 && (cursor.dy == 1 || cursor.dy == -1)) || (cursor.dy == 0 && (cursor.dx == 1 || cursor.dx == -1)));
+}
+
+bool Checkpoint::Restore(const CheckpointData& data, Grid& grid)
+{
+	// everything is checked before the grid is allocated
+	if (!Valid(data.width, data.height, data.layout) || data.cells.size() != Grid::Cells(data.width, data.height, data.layout))
+	{
+		return false;
+	}
+	for (const Cursor& cursor : data.cursors)
+	{
+		if (!Valid(cursor, data.width, data.height)) { return false; }
+	}
+	for (const Cursor& cursor : data.queued)
+	{
+		if (!Valid(cursor, data.width, data.height)) { return false; }
+	}
+
+	Grid restored(data.width, data.height, data.layout);
+	std::copy(data.cells.begin(), data.cells.end(), restored.gridData);
+	restored.cursors = data.cursors;
+	restored.cursorsToAdd = data.queued;
+	restored.counters = data.counters;
+
+	grid = std::move(restored);
+	return true;
+}
+
+CheckpointCursor Checkpoint::Encode(const Cursor& cursor)
+{
+	CheckpointCursor encoded;
+	encoded.ipX = cursor.ip.x;
+	encoded.ipY = cursor.ip.y;
+	encoded.ipPreviousX = cursor.ip.prevX;
+	encoded.ipPreviousY = cursor.ip.prevY;
+	encoded.selectedX = cursor.selected.x;
+	encoded.selectedY = cursor.selected.y;
+	encoded.selectedPreviousX = cursor.selected.prevX;
+	encoded.selectedPreviousY = cursor.selected.prevY;
+	encoded.selectedWidth = cursor.selected.width;
+	encoded.dx = cursor.dx;
+	encoded.dy = cursor.dy;
+	encoded.wrapped =
+		(cursor.ip.wrappedX ? 1u : 0u) | (cursor.ip.wrappedY ? 2u : 0u) |
+		(cursor.selected.wrappedX ? 4u : 0u) | (cursor.selected.wrappedY ? 8u : 0u);
+	return encoded;
+}
+
+Cursor Checkpoint::Decode(const CheckpointCursor& encoded)
+{
+	Cursor cursor(encoded.ipX, encoded.ipY, encoded.selectedX, encoded.selectedY, encoded.selectedWidth, encoded.dx, encoded.dy);
+	cursor.ip.prevX = encoded.ipPreviousX;
+	cursor.ip.prevY = encoded.ipPreviousY;
+	cursor.ip.wrappedX = (encoded.wrapped & 1u) != 0;
+	cursor.ip.wrappedY = (encoded.wrapped & 2u) != 0;
+	cursor.selected.prevX = encoded.selectedPreviousX;
+	cursor.selected.prevY = encoded.selectedPreviousY;
+	cursor.selected.wrappedX = (encoded.wrapped & 4u) != 0;
+	cursor.selected.wrappedY = (encoded.wrapped & 8u) != 0;
+	return cursor;
+}
+
+bool Checkpoint::Write(const CheckpointData& data, const std::string& path)
+{
+	const bool narrow = std::all_of(data.cells.begin(), data.cells.end(), [](int cell) { return cell >= 0 && cell <= 0xFF; });
+
+	CheckpointHeader header;
+	std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+	header.version = checkpointVersion;
+	header.width = data.width;
+	header.height = data.height;
+	header.layout = static_cast<uint32_t>(data.layout);
+	header.cellBytes = narrow ? 1 : 4;
+	header.cellCount = data.cells.size();
+	header.cursorCount = data.cursors.size();
+	header.queuedCount = data.queued.size();
+	header.steps = data.counters.steps;
+	header.executions = data.counters.executions;
+	header.writes = data.counters.writes;
+
+	// write beside the old checkpoint and swap it in, so a crash at any point leaves a whole checkpoint
+	const std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream out(temporaryPath, std::ios_base::binary | std::ios_base::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		if (narrow)
+		{
+			std::vector<uint8_t> bytes;
+			for (size_t i = 0; i < data.cells.size(); i += checkpointChunk)
+			{
+				const size_t end = std::min(data.cells.size(), i + checkpointChunk);
+				bytes.assign(data.cells.begin() + i, data.cells.begin() + end);
+				out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+			}
+		}
+		else
+		{
+			out.write(reinterpret_cast<const char*>(data.cells.data()), data.cells.size() * sizeof(int32_t));
+		}
+
+		for (const std::vector<Cursor>* cursors : { &data.cursors, &data.queued })
+		{
+			for (const Cursor& cursor : *cursors)
+			{
+				const CheckpointCursor encoded = Encode(cursor);
+				out.write(reinterpret_cast<const char*>(&encoded), sizeof(encoded));
+			}
+		}
+
+		out.flush();
+		if (!out) { return false; }
+	}
+
+	return ReplaceFile(temporaryPath, path);
+}
+
+bool Checkpoint::Read(const std::string& path, CheckpointData& data)
+{
+	std::ifstream in(path, std::ios_base::binary);
+	CheckpointHeader header;
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		std::memcmp(header.magic, checkpointMagic, sizeof(header.magic)) != 0 || header.version != checkpointVersion ||
+		(header.cellBytes != 1 && header.cellBytes != 4) ||
+		!Valid(header.width, header.height, static_cast<GridLayout>(header.layout)) ||
+		header.cellCount != Grid::Cells(header.width, header.height, static_cast<GridLayout>(header.layout)))
+	{
+		return false;
+	}
+
+	// check the counts against the file's size before allocating anything for them
+	in.seekg(0, std::ios_base::end);
+	const uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+	in.seekg(sizeof(header), std::ios_base::beg);
+	const uint64_t limit = fileSize - sizeof(header);
+	if (header.cellCount > limit / header.cellBytes ||
+		header.cursorCount > limit / sizeof(CheckpointCursor) || header.queuedCount > limit / sizeof(CheckpointCursor) ||
+		header.cellCount * header.cellBytes + (header.cursorCount + header.queuedCount) * sizeof(CheckpointCursor) != limit)
+	{
+		return false;
+	}
+
+	data.width = header.width;
+	data.height = header.height;
+	data.layout = static_cast<GridLayout>(header.layout);
+
+	data.cells.resize(static_cast<size_t>(header.cellCount));
+	if (header.cellBytes == 1)
+	{
+		std::vector<uint8_t> bytes;
+		for (size_t i = 0; i < data.cells.size(); i += checkpointChunk)
+		{
+			const size_t end = std::min(data.cells.size(), i + checkpointChunk);
+			bytes.resize(end - i);
+			if (!in.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) { return false; }
+			std::copy(bytes.begin(), bytes.end(), data.cells.begin() + i);
+		}
+	}
+	else if (!in.read(reinterpret_cast<char*>(data.cells.data()), data.cells.size() * sizeof(int32_t)))
+	{
+		return false;
+	}
+
+	data.cursors.clear();
+	data.queued.clear();
+	for (uint64_t i = 0; i < header.cursorCount + header.queuedCount; i++)
+	{
+		CheckpointCursor encoded;
+		if (!in.read(reinterpret_cast<char*>(&encoded), sizeof(encoded))) { return false; }
+		(i < header.cursorCount ? data.cursors : data.queued).push_back(Decode(encoded));
+	}
+
+	data.counters = GridCounters();
+	data.counters.steps = header.steps;
+	data.counters.executions = header.executions;
+	data.counters.writes = header.writes;
+	return true;
+}
+
+bool Checkpoint::Save(const Grid& grid, const std::string& path)
+{
+	CheckpointData data;
+	Capture(grid, data);
+	return Write(data, path);
+}
+
+bool Checkpoint::Load(const std::string& path, Grid& grid)
+{
+	CheckpointData data;
+	return Read(path, data) && Restore(data, grid);
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& path, std::chrono::milliseconds interval) :
+	path(path), interval(interval), lastStart(std::chrono::steady_clock::now()), lastCheck(), stride(1), countdown(1),
+	data(), busy(false), stopping(false), lastWritten(false), written(0), failed(0)
+{
+	thread = std::thread(&CheckpointWriter::Run, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	ready.notify_one();
+	thread.join();
+}
+
+bool CheckpointWriter::Check(const Grid& grid)
+{
+	const auto now = std::chrono::steady_clock::now();
+
+	// aim for one clock read per millisecond, but never wait out more than a tenth of the interval
+	const std::chrono::steady_clock::duration target = std::min<std::chrono::steady_clock::duration>(
+		std::chrono::milliseconds(1), std::chrono::steady_clock::duration(interval) / 10);
+	const auto elapsed = now - lastCheck;
+	if (elapsed < target / 2 && stride < (1u << 20))
+	{
+		stride *= 2;
+	}
+	else if (elapsed > target * 2 && stride > 1)
+	{
+		stride /= 2;
+	}
+	lastCheck = now;
+	countdown = stride;
+
+	if (now - lastStart < interval) { return false; }
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (busy) { return false; }
+	}
+
+	Start(grid);
+	lastStart = now;
+	return true;
+}
+
+void CheckpointWriter::Start(const Grid& grid)
+{
+	// the writer thread is idle, so it is not reading data
+	Checkpoint::Capture(grid, data);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		busy = true;
+	}
+	ready.notify_one();
+}
+
+void CheckpointWriter::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return !busy; });
+}
+
+bool CheckpointWriter::Save(const Grid& grid)
+{
+	Wait();
+	Start(grid);
+	lastStart = std::chrono::steady_clock::now();
+	Wait();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	return lastWritten;
+}
+
+uint64_t CheckpointWriter::Written() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return written;
+}
+
+uint64_t CheckpointWriter::Failed() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed;
+}
+
+void CheckpointWriter::Run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		ready.wait(lock, [this] { return busy || stopping; });
+		// a checkpoint started before stopping is still written
+		if (!busy) { return; }
+
+		lock.unlock();
+		const bool ok = Checkpoint::Write(data, path);
+		lock.lock();
+
+		lastWritten = ok;
+		if (ok) { written++; }
+		else { failed++; }
+		busy = false;
+		idle.notify_all();
+	}
+}
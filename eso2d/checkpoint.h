@@ -0,0 +1,162 @@
+#pragma once
+
+#include "eso2d.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Everything needed to resume a grid exactly, copied out of it.
+/// </summary>
+struct CheckpointData
+{
+	int width;
+	int height;
+	GridLayout layout;
+	// in memory order, including any padding the layout needs
+	std::vector<int> cells;
+	// with previous positions and wrap flags, so the next Move or Set behaves as it would have
+	std::vector<Cursor> cursors;
+	// queued by splits, not yet added
+	std::vector<Cursor> queued;
+	// steps, executions and writes. times are not kept
+	GridCounters counters;
+};
+
+/// <summary>
+/// Saves a running grid to a compact binary file and resumes it bit-exactly: stepping a restored grid gives the same cells and cursors, step for step, as the grid it was saved from.
+/// Limits and timing are not part of a checkpoint, so set them again after resuming.
+/// Files are native-endian, like the journal, and are replaced atomically so a crash mid-save keeps the previous checkpoint.
+/// </summary>
+class Checkpoint
+{
+public:
+	/// <summary>
+	/// Copy a grid's state. Costs about as much as copying its cells.
+	/// </summary>
+	/// <param name="grid">Grid to copy from.</param>
+	/// <param name="data">Replaced with the grid's state. Reusing the same data avoids reallocating.</param>
+	static void Capture(const Grid& grid, CheckpointData& data);
+	/// <summary>
+	/// Rebuild a grid from a copied state.
+	/// </summary>
+	/// <param name="data">State from Capture or Read.</param>
+	/// <param name="grid">Replaced with the restored grid on success. A mapped grid is replaced by an in-memory one.</param>
+	/// <returns>True if restored, false if the state is inconsistent. The grid is unchanged on failure.</returns>
+	static bool Restore(const CheckpointData& data, Grid& grid);
+
+	/// <summary>
+	/// Write a state to a file, replacing it only once the new file is complete.
+	/// </summary>
+	/// <param name="data">State to write.</param>
+	/// <param name="path">Checkpoint file.</param>
+	/// <returns>True if written, false otherwise.</returns>
+	static bool Write(const CheckpointData& data, const std::string& path);
+	/// <summary>
+	/// Read a state written by Write.
+	/// </summary>
+	/// <param name="path">Checkpoint file.</param>
+	/// <param name="data">Filled with the state on success.</param>
+	/// <returns>True if read, false if the file is missing, truncated or not a checkpoint.</returns>
+	static bool Read(const std::string& path, CheckpointData& data);
+
+	/// <summary>
+	/// Capture and write a grid in one call, blocking until the file is written.
+	/// </summary>
+	static bool Save(const Grid& grid, const std::string& path);
+	/// <summary>
+	/// Read and restore a grid in one call.
+	/// </summary>
+	static bool Load(const std::string& path, Grid& grid);
+
+private:
+	// true if a grid this size and layout can be made, and every cell has an int index
+	static bool Valid(int width, int height, GridLayout layout);
+	// true if every position is on a grid this size and the direction is one of the four unit steps, so a restored cursor cannot step off it
+	static bool Valid(const Cursor& cursor, int width, int height);
+	static struct CheckpointCursor Encode(const Cursor& cursor);
+	static Cursor Decode(const struct CheckpointCursor& encoded);
+};
+
+/// <summary>
+/// Checkpoints a running grid periodically from a background thread.
+/// A checkpoint pauses the run only to copy the cells and cursors; encoding and writing happen while it keeps stepping.
+/// A checkpoint that falls due while the previous one is still being written is put off until it finishes.
+/// Between checkpoints, most calls to Update only decrement a counter.
+/// </summary>
+class CheckpointWriter
+{
+public:
+	/// <summary>
+	/// Start the writer thread. Nothing is written until the first checkpoint is due.
+	/// </summary>
+	/// <param name="path">Checkpoint file, replaced by each checkpoint.</param>
+	/// <param name="interval">Minimum time between checkpoints.</param>
+	CheckpointWriter(const std::string& path, std::chrono::milliseconds interval);
+	/// <summary>
+	/// Finish any checkpoint being written, and stop the writer thread.
+	/// </summary>
+	~CheckpointWriter();
+
+	CheckpointWriter(const CheckpointWriter&) = delete;
+	CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+	/// <summary>
+	/// Start a checkpoint if the interval has passed since the last one. Call once per step.
+	/// </summary>
+	/// <param name="grid">Running grid.</param>
+	/// <returns>True if a checkpoint was started.</returns>
+	bool Update(const Grid& grid)
+	{
+		if (--countdown > 0) { return false; }
+		return Check(grid);
+	}
+	/// <summary>
+	/// Checkpoint the grid now, waiting for it and any earlier checkpoint to reach the file.
+	/// </summary>
+	/// <param name="grid">Grid to checkpoint.</param>
+	/// <returns>True if this checkpoint was written, false otherwise.</returns>
+	bool Save(const Grid& grid);
+
+	/// <summary>
+	/// Number of checkpoints written so far.
+	/// </summary>
+	uint64_t Written() const;
+	/// <summary>
+	/// Number of checkpoints that could not be written. The previous file is kept when one fails.
+	/// </summary>
+	uint64_t Failed() const;
+
+private:
+	// read the clock, start a checkpoint if due, and pick how many calls to skip before reading it again
+	bool Check(const Grid& grid);
+	// copy the grid and hand it to the writer thread. the thread must be idle
+	void Start(const Grid& grid);
+	// wait until the writer thread is idle
+	void Wait();
+	void Run();
+
+	std::string path;
+	std::chrono::milliseconds interval;
+	std::chrono::steady_clock::time_point lastStart;
+	std::chrono::steady_clock::time_point lastCheck;
+	uint32_t stride;
+	uint32_t countdown;
+
+	// owned by the writer thread while busy, by the stepping thread otherwise
+	CheckpointData data;
+	mutable std::mutex mutex;
+	std::condition_variable ready;
+	std::condition_variable idle;
+	bool busy;
+	bool stopping;
+	bool lastWritten;
+	uint64_t written;
+	uint64_t failed;
+	std::thread thread;
+};
@@ -0,0 +1,132 @@
+#include "debugger.h"
+
+#include <algorithm>
+#include <cassert>
+
+Debugger::Debugger(int width, int height) :
+	width(width), height(height), flags(width * height, 0), flagged(0),
+	cursorLimitSet(false), cursorLimit(0), stepBreakSet(false), stepBreak(0),
+	step(0), cursors(0)
+{
+	assert(width > 0 && height > 0);
+	Resume();
+}
+
+void Debugger::SetBreakpoint(int x, int y, bool enabled)
+{
+	SetFlag(x, y, BreakpointFlag, enabled);
+}
+
+bool Debugger::HasBreakpoint(int x, int y) const
+{
+	return x >= 0 && y >= 0 && x < width && y < height && (flags[x + y * width] & BreakpointFlag);
+}
+
+void Debugger::SetWatchpoint(int x, int y, bool enabled)
+{
+	SetFlag(x, y, WatchpointFlag, enabled);
+}
+
+bool Debugger::HasWatchpoint(int x, int y) const
+{
+	return x >= 0 && y >= 0 && x < width && y < height && (flags[x + y * width] & WatchpointFlag);
+}
+
+void Debugger::SetWatchRegion(int x, int y, int width, int height, bool enabled)
+{
+	const int left = std::max(x, 0);
+	const int top = std::max(y, 0);
+	const int right = std::min(x + width, this->width);
+	const int bottom = std::min(y + height, this->height);
+	for (int j = top; j < bottom; j++)
+	{
+		for (int i = left; i < right; i++)
+		{
+			SetFlag(i, j, WatchpointFlag, enabled);
+		}
+	}
+}
+
+void Debugger::BreakWhenCursorsAbove(size_t count)
+{
+	cursorLimitSet = true;
+	cursorLimit = count;
+}
+
+void Debugger::BreakAtStep(uint64_t step)
+{
+	stepBreakSet = true;
+	stepBreak = step;
+}
+
+void Debugger::ClearConditions()
+{
+	cursorLimitSet = false;
+	stepBreakSet = false;
+}
+
+void Debugger::Clear()
+{
+	std::fill(flags.begin(), flags.end(), 0);
+	flagged = 0;
+	ClearConditions();
+	Resume();
+}
+
+bool Debugger::Empty() const
+{
+	return flagged == 0 && !cursorLimitSet && !stepBreakSet;
+}
+
+bool Debugger::Stopped() const { return stop.kind != DebugStop::None; }
+const DebugStop& Debugger::Stop() const { return stop; }
+
+void Debugger::Resume()
+{
+	stop = DebugStop { DebugStop::None, -1, -1, 0, 0 };
+}
+
+void Debugger::Print(const Grid& grid) const
+{
+	Layer(0);
+	for (int j = 0; j < height && j < grid.Height(); j++)
+	{
+		for (int i = 0; i < width && i < grid.Width(); i++)
+		{
+			const uint8_t flag = flags[i + j * width];
+			if (!flag) { continue; }
+
+			if (flag & BreakpointFlag)
+			{
+				SetColor(MakeColor(0xFF, 0x33, 0x33, 0xFF));
+			}
+			else
+			{
+				SetColor(MakeColor(0x33, 0xCC, 0xFF, 0xFF));
+			}
+			// empty cells still need to show their marker
+			Put(i, j, grid(i, j) == OpCode::None ? 0x00B7 : grid(i, j));
+		}
+	}
+}
+
+void Debugger::SetFlag(int x, int y, uint8_t flag, bool enabled)
+{
+	if (x < 0 || y < 0 || x >= width || y >= height) { return; }
+
+	uint8_t& cell = flags[x + y * width];
+	const bool wasFlagged = cell != 0;
+	cell = enabled ? (cell | flag) : (cell & ~flag);
+	const bool isFlagged = cell != 0;
+
+	if (isFlagged && !wasFlagged) { flagged++; }
+	if (!isFlagged && wasFlagged) { flagged--; }
+}
+
+void Debugger::Hit(DebugStop::Kind kind, int x, int y)
+{
+	// keep the first stop of a run until resumed
+	if (stop.kind != DebugStop::None) { return; }
+
+	stop = DebugStop { kind, x, y, step, cursors };
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "eso2d.h"
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// Why a Debugger stopped.
+/// </summary>
+struct DebugStop
+{
+	enum Kind
+	{
+		None,
+		Breakpoint, // a cursor executed a breakpoint cell
+		Watchpoint, // a cursor wrote to a watched cell
+		CursorCount, // more cursors were alive than the limit
+		StepReached // the requested step was reached
+	};
+
+	Kind kind;
+	// cell for Breakpoint and Watchpoint
+	int x;
+	int y;
+	// completed steps when the step containing the stop began
+	uint64_t step;
+	// live cursors when the step containing the stop began
+	size_t cursors;
+};
+
+/// <summary>
+/// Hook policy for breakpoints, watchpoints and conditional breaks.
+/// Breakpoints and watchpoints are flags in one byte per cell, so each check is a single lookup.
+/// The step that hits a stop always runs to completion, so results match an undebugged run; check Stopped after each Update.
+/// When Empty, callers can use the plain Grid::Update and pay nothing.
+/// </summary>
+class Debugger
+{
+public:
+	/// <summary>
+	/// Create a debugger with nothing set.
+	/// </summary>
+	/// <param name="width">Width of the grid it will debug.</param>
+	/// <param name="height">Height of the grid it will debug.</param>
+	Debugger(int width, int height);
+
+	/// <summary>
+	/// Stop when any cursor executes the instruction at (x, y), including one run through a side indicator.
+	/// A cell jumped over by Skip is not executed, so never stops.
+	/// </summary>
+	void SetBreakpoint(int x, int y, bool enabled);
+	bool HasBreakpoint(int x, int y) const;
+	/// <summary>
+	/// Stop when any cursor writes to (x, y).
+	/// </summary>
+	void SetWatchpoint(int x, int y, bool enabled);
+	bool HasWatchpoint(int x, int y) const;
+	/// <summary>
+	/// Stop when any cursor writes inside a rectangle. Cells outside the grid are ignored.
+	/// </summary>
+	void SetWatchRegion(int x, int y, int width, int height, bool enabled);
+
+	/// <summary>
+	/// Stop once more than this many cursors are alive at the start of a step.
+	/// </summary>
+	void BreakWhenCursorsAbove(size_t count);
+	/// <summary>
+	/// Stop once this many steps have completed.
+	/// </summary>
+	void BreakAtStep(uint64_t step);
+	void ClearConditions();
+	/// <summary>
+	/// Remove every breakpoint, watchpoint and condition.
+	/// </summary>
+	void Clear();
+
+	/// <summary>
+	/// True if nothing can stop the program, so the plain Grid::Update can be used instead.
+	/// </summary>
+	bool Empty() const;
+
+	bool Stopped() const;
+	const DebugStop& Stop() const;
+	/// <summary>
+	/// Clear the current stop, so the next one can be recorded.
+	/// </summary>
+	void Resume();
+
+	/// <summary>
+	/// Highlight breakpoints and watchpoints over the grid.
+	/// </summary>
+	void Print(const Grid& grid) const;
+
+	void OnStep(const Grid& grid)
+	{
+		assert(grid.Width() == width && grid.Height() == height);
+
+		step = grid.Counters().steps;
+		cursors = grid.Cursors().size();
+		if (cursorLimitSet && cursors > cursorLimit)
+		{
+			Hit(DebugStop::CursorCount, -1, -1);
+		}
+		// this step is the one that completes the requested step
+		if (stepBreakSet && step + 1 == stepBreak)
+		{
+			Hit(DebugStop::StepReached, -1, -1);
+		}
+	}
+
+	void OnExecute(const Grid&, const Cursor& cursor, int)
+	{
+		const int x = cursor.IP().X();
+		const int y = cursor.IP().Y();
+		if (flags[x + y * width] & BreakpointFlag) { Hit(DebugStop::Breakpoint, x, y); }
+	}
+
+	void OnWrite(const Grid&, int x, int y, int, int)
+	{
+		if (flags[x + y * width] & WatchpointFlag) { Hit(DebugStop::Watchpoint, x, y); }
+	}
+
+	void OnSpawn(const Grid&, const Cursor&, const Cursor&) { }
+	void OnDeath(const Grid&, const Cursor&) { }
+
+private:
+	enum Flag : uint8_t
+	{
+		BreakpointFlag = 1,
+		WatchpointFlag = 2
+	};
+
+	void SetFlag(int x, int y, uint8_t flag, bool enabled);
+	void Hit(DebugStop::Kind kind, int x, int y);
+
+	int width;
+	int height;
+	std::vector<uint8_t> flags;
+	size_t flagged;
+
+	bool cursorLimitSet;
+	size_t cursorLimit;
+	bool stepBreakSet;
+	uint64_t stepBreak;
+
+	uint64_t step;
+	size_t cursors;
+	DebugStop stop;
+};
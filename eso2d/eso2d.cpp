@@ -1,6 +1,9 @@
 #include "eso2d.h"
+#include "mapped_file.h"
 
 #include <algorithm>
+#include <cstring>
+#include <memory>
 
 #include <cassert>
 
@@ -16,6 +19,34 @@ static int Wrap(int a, int b)
 	}
 }
 
+// layout of a mapped grid file: this header, then the cells in memory order
+struct MappedGridHeader
+{
+	char magic[4];
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	// GridLayout of the cells. version 1 files end the header before this, and are always row-major
+	int32_t layout;
+	int32_t reserved;
+};
+
+static const char mappedGridMagic[4] = { 'E', '2', 'D', 'M' };
+static const uint32_t mappedGridVersion = 2;
+static const size_t mappedGridHeaderSizeV1 = 16;
+
+static_assert(sizeof(int) == sizeof(int32_t), "mapped grids store cells as 32-bit integers");
+
+static int WrapMask(int size)
+{
+	return size > 0 && (size & (size - 1)) == 0 ? size - 1 : -1;
+}
+
+static int BlockColumns(int width, GridLayout layout)
+{
+	return layout == GridLayout::Blocked ? (width + 3) / 4 : 0;
+}
+
 Selection::Selection() : Selection(0, 0) { }
 Selection::Selection(int x, int y) : x(x), y(y), prevX(x), prevY(y), wrappedX(false), wrappedY(false) { }
 
@@ -52,13 +83,13 @@ void Selection::SetPosition(int x, int y, const Grid& grid)
 
 	if (x < 0 || x >= grid.Width())
 	{
-		x = Wrap(x, grid.Width());
+		x = grid.WrapX(x);
 		wrappedX = true;
 	}
 
 	if (y < 0 || y >= grid.Height())
 	{
-		y = Wrap(y, grid.Height());
+		y = grid.WrapY(y);
 		wrappedY = true;
 	}
 
@@ -74,6 +105,12 @@ void Selection::MoveBy(int dx, int dy, const Grid& grid)
 	SetPosition(x + dx, y + dy, grid);
 }
 
+bool Selection::operator==(const Selection& other) const
+{
+	return x == other.x && y == other.y && prevX == other.prevX && prevY == other.prevY && wrappedX == other.wrappedX && wrappedY == other.wrappedY;
+}
+bool Selection::operator!=(const Selection& other) const { return !(*this == other); }
+
 WSelection::WSelection() : WSelection(0, 0, 1) { }
 WSelection::WSelection(int x, int y, int w) : Selection(x, y), width(w < 1 ? 1 : w) { }
 
@@ -101,291 +138,37 @@ void WSelection::Shrink(const Grid& grid)
 	if (width > 1) { width--; }
 }
 
+bool WSelection::operator==(const WSelection& other) const
+{
+	return Selection::operator==(other) && width == other.width;
+}
+bool WSelection::operator!=(const WSelection& other) const { return !(*this == other); }
+
 Cursor::Cursor() : Cursor(0, 0, 0, 0) { }
 Cursor::Cursor(int ipx, int ipy, int sx, int sy) : Cursor(ipx, ipy, sx, sy, 1, 1, 0) { }
 Cursor::Cursor(int ipx, int ipy, int sx, int sy, int sw, int dx, int dy) : ip(ipx, ipy), selected(sx, sy, sw), dx(dx), dy(dy) { }
 
+const Selection& Cursor::IP() const { return ip; }
+const WSelection& Cursor::Selected() const { return selected; }
+int Cursor::DX() const { return dx; }
+int Cursor::DY() const { return dy; }
+
+bool Cursor::operator==(const Cursor& other) const
+{
+	return ip == other.ip && selected == other.selected && dx == other.dx && dy == other.dy;
+}
+bool Cursor::operator!=(const Cursor& other) const { return !(*this == other); }
+
 void Cursor::Print(const Grid& grid) const
 {
 	ip.Print(grid);
 	selected.Print(grid);
 }
 
-enum class Side
-{
-	None,
-	Left,
-	All,
-	Right
-};
-
 bool Cursor::Update(Grid& grid)
 {
-	int instruction = grid(ip);
-	Side side = Side::None;
-
-	switch (instruction)
-	{
-	case OpCode::IPStart:
-	case OpCode::Path:
-		break;
-
-	case OpCode::Skip:
-		ip.MoveBy(dx, dy, grid);
-		break;
-
-	case OpCode::Left:
-		selected.MoveBy(-1, 0, grid);
-		break;
-
-	case OpCode::Right:
-		selected.MoveBy(1, 0, grid);
-		break;
-
-	case OpCode::Up:
-		selected.MoveBy(0, -1, grid);
-		break;
-
-	case OpCode::Down:
-		selected.MoveBy(0, 1, grid);
-		break;
-
-	case OpCode::Widen:
-		selected.Widen(grid);
-		break;
-
-	case OpCode::Shrink:
-		selected.Shrink(grid);
-		break;
-
-	case OpCode::Move:
-		if (selected.MovedRight())
-		{
-			// moving right, iterate from right-to-left
-			for (int i = selected.Width() - 1; i >= 0; i--)
-			{
-				grid(selected)(i) = grid(selected, true)(i);
-			}
-		}
-		else if (selected.MovedLeft() || selected.Y() != selected.PreviousY())
-		{
-			// moving left, iterate from left-to-right
-			// moving up or down, iteration order doesn't matter, memory will not overlap
-			for (int i = 0; i < selected.Width(); i++)
-			{
-				grid(selected)(i) = grid(selected, true)(i);
-			}
-		}
-		break;
-
-	case OpCode::Increment:
-	{
-		int value = 0; // sum
-		int placeValue = 1;
-		bool validOperation = true;
-		for (int i = selected.Width() - 1; i >= 0; i--)
-		{
-			// check if grid state is a number
-			int gridValue = grid(selected)(i);
-			if (gridValue < '0' || gridValue > '9') { validOperation = false; }
-
-			value += (gridValue - '0') * placeValue; // digit * place value
-			placeValue *= 10; // increment place value every iteration
-		}
-
-		// do nothing if not a valid number
-		if (!validOperation) { break; }
-		
-		value += 1; // increment
-		
-		placeValue = 1;
-		
-		for (int i = selected.Width() - 1; i >= 0; i--)
-		{
-			// divide by place value to make single digit (also truncates unneeded digits due to integer type)
-			// add to '0' to map to character range
-			grid(selected)(i) = '0' + (value % (placeValue * 10) / placeValue);
-			placeValue *= 10;
-		}
-		break;
-	}
-
-	case OpCode::Decrement:
-	{
-		int value = 0; // sum
-		int placeValue = 1;
-		bool validOperation = true;
-		for (int i = selected.Width() - 1; i >= 0; i--)
-		{
-			// check if grid state is a number
-			int gridValue = grid(selected)(i);
-			if (gridValue < '0' || gridValue > '9') { validOperation = false; }
-
-			value += (gridValue - '0') * placeValue; // digit * place value
-			placeValue *= 10; // increment place value every iteration
-		}
-
-		// do nothing if not a valid number
-		if (!validOperation) { break; }
-
-		value -= 1;
-		if (value < 0) { value = 0; } // no negative number support in this esolang
-		
-		placeValue = 1;
-		
-		for (int i = selected.Width() - 1; i >= 0; i--)
-		{
-			// divide by place value to make single digit (also truncates unneeded digits due to integer type)
-			grid(selected)(i) = '0' + (value % (placeValue * 10) / placeValue);
-			placeValue *= 10; // increment place value every iteration
-		}
-		break;
-	}
-
-	case OpCode::Set:
-		ip.MoveBy(dx, dy, grid);
-		for (int i = 0; i < selected.Width(); i++)
-		{
-			grid(selected)(i) = grid(ip);
-		}
-		break;
-
-	case OpCode::Conditional:
-	{
-		bool equal = true;
-		ip.MoveBy(dx, dy, grid);
-		int gridValue = grid(ip);
-		switch (gridValue)
-		{
-		case 'N':
-			for (int i = 0; i < selected.Width(); i++)
-			{
-				if (grid(selected)(i) < '0' || grid(selected)(i) > '9')
-				{
-					equal = false;
-					break;
-				}
-			}
-			break;
-
-		default:
-			for (int i = 0; i < selected.Width(); i++)
-			{
-				if (gridValue != grid(selected)(i))
-				{
-					equal = false;
-					break;
-				}
-			}
-			break;
-		}
-		if (equal)
-		{
-			TurnLeft();
-		}
-		else
-		{
-			TurnRight();
-		}
-		break;
-	}
-
-	case OpCode::Split:
-	{
-		Cursor other(*this);
-		other.TurnLeft();
-		other.Move(grid);
-		TurnRight();
-		grid.QueueAddCursor(other);
-		break;
-	}
-
-	case OpCode::LeftIndicator:
-		side = Side::Left;
-		break;
-
-	case OpCode::RightIndicator:
-		side = Side::Right;
-		break;
-
-	default: // OpCode::Terminate is also covered here
-		return false;
-	}
-
-	Move(grid);
-
-	if (side != Side::None)
-	{
-		instruction = grid(ip);
-		int& target = side == Side::Left ? grid(selected)(0) : grid(selected)(selected.Width() - 1);
-		switch (instruction)
-		{
-		case OpCode::Conditional:
-			ip.MoveBy(dx, dy, grid);
-			switch (grid(ip))
-			{
-			case 'W':
-				if (side == Side::Right)
-				{
-					if (selected.Width() == grid.Width())
-					{
-						TurnLeft();
-					}
-					else
-					{
-						TurnRight();
-					}
-				}
-				else
-				{
-					if (selected.Width() == 1)
-					{
-						TurnLeft();
-					}
-					else
-					{
-						TurnRight();
-					}
-				}
-				break;
-
-			case 'N':
-				if (target >= '0' && target <= '9')
-				{
-					TurnLeft();
-				}
-				else
-				{
-					TurnRight();
-				}
-				break;
-
-			default:
-				if (grid(ip) == target)
-				{
-					TurnLeft();
-				}
-				else
-				{
-					TurnRight();
-				}
-				break;
-			}
-			Move(grid);
-			break;
-
-		case OpCode::Set:
-			ip.MoveBy(dx, dy, grid);
-			target = grid(ip);
-			Move(grid);
-			break;
-
-		default:
-			return false;
-		}
-	}
-
-	return true;
+	NullHooks hooks;
+	return Update(grid, hooks);
 }
 
 void Cursor::Move(Grid& grid)
@@ -438,14 +221,123 @@ void Cursor::TurnRight()
 	}
 }
 
+void Cursor::Conditional(const Grid& grid)
+{
+	bool equal = true;
+	ip.MoveBy(dx, dy, grid);
+	int gridValue = grid(ip);
+	switch (gridValue)
+	{
+	case 'N':
+		for (int i = 0; i < selected.Width(); i++)
+		{
+			if (grid(selected)(i) < '0' || grid(selected)(i) > '9')
+			{
+				equal = false;
+				break;
+			}
+		}
+		break;
+
+	default:
+		for (int i = 0; i < selected.Width(); i++)
+		{
+			if (gridValue != grid(selected)(i))
+			{
+				equal = false;
+				break;
+			}
+		}
+		break;
+	}
+	if (equal)
+	{
+		TurnLeft();
+	}
+	else
+	{
+		TurnRight();
+	}
+}
+
+void Cursor::SideConditional(Grid& grid, Side side)
+{
+	int target = grid(selected)(side == Side::Left ? 0 : selected.Width() - 1);
+	ip.MoveBy(dx, dy, grid);
+	switch (grid(ip))
+	{
+	case 'W':
+		if (side == Side::Right)
+		{
+			if (selected.Width() == grid.Width())
+			{
+				TurnLeft();
+			}
+			else
+			{
+				TurnRight();
+			}
+		}
+		else
+		{
+			if (selected.Width() == 1)
+			{
+				TurnLeft();
+			}
+			else
+			{
+				TurnRight();
+			}
+		}
+		break;
+
+	case 'N':
+		if (target >= '0' && target <= '9')
+		{
+			TurnLeft();
+		}
+		else
+		{
+			TurnRight();
+		}
+		break;
+
+	default:
+		if (grid(ip) == target)
+		{
+			TurnLeft();
+		}
+		else
+		{
+			TurnRight();
+		}
+		break;
+	}
+	Move(grid);
+}
+
 void swap(Grid& first, Grid& second) noexcept
 {
 	using std::swap;
 
 	swap(first.width, second.width);
 	swap(first.height, second.height);
+	swap(first.widthMask, second.widthMask);
+	swap(first.heightMask, second.heightMask);
+	swap(first.layout, second.layout);
+	swap(first.blockColumns, second.blockColumns);
 	swap(first.gridData, second.gridData);
+	swap(first.mapping, second.mapping);
 	swap(first.cursors, second.cursors);
+	swap(first.cursorsToAdd, second.cursorsToAdd);
+	swap(first.timing, second.timing);
+	swap(first.counters, second.counters);
+	swap(first.limits, second.limits);
+	swap(first.stepThreshold, second.stepThreshold);
+	swap(first.writeThreshold, second.writeThreshold);
+	swap(first.clockThreshold, second.clockThreshold);
+	swap(first.deadline, second.deadline);
+	swap(first.stopReason, second.stopReason);
 }
 
 std::ostream& operator<<(std::ostream& out, const Grid& grid)
@@ -467,28 +359,37 @@ std::istream& operator>>(std::istream& in, Grid& grid)
 	int w, h;
 	in >> w;
 	in >> h;
-	Grid tmp(w, h);
-	for (int i = 0; i < grid.width; i++)
+	if (!in || w <= 0 || h <= 0)
 	{
-		for (int j = 0; j < grid.height; j++)
+		in.setstate(std::ios_base::failbit);
+		return in;
+	}
+
+	Grid tmp(w, h, grid.layout);
+	for (int i = 0; i < w; i++)
+	{
+		for (int j = 0; j < h; j++)
 		{
 			in >> tmp(i, j);
 		}
 	}
-	grid = std::move(tmp);
+	if (in)
+	{
+		grid = std::move(tmp);
+	}
 	return in;
 }
 
-Grid::Grid() : width(0), height(0), gridData(nullptr) { }
-Grid::Grid(int w, int h) : width(w), height(h), gridData(new int[w * h])
+Grid::Grid() : width(0), height(0), widthMask(-1), heightMask(-1), layout(GridLayout::RowMajor), blockColumns(0), gridData(nullptr), mapping(nullptr), timing(false), counters(), limits(), stepThreshold(UINT64_MAX), writeThreshold(UINT64_MAX), clockThreshold(UINT64_MAX), deadline(), stopReason(GridStatus::Running) { }
+Grid::Grid(int w, int h, GridLayout layout) : width(w), height(h), widthMask(WrapMask(w)), heightMask(WrapMask(h)), layout(layout), blockColumns(BlockColumns(w, layout)), gridData(new int[size_t(Cells(w, h, layout))]), mapping(nullptr), timing(false), counters(), limits(), stepThreshold(UINT64_MAX), writeThreshold(UINT64_MAX), clockThreshold(UINT64_MAX), deadline(), stopReason(GridStatus::Running)
 {
 	assert(w > 0 && h > 0);
-	std::fill(gridData, gridData + width * height, OpCode::None);
+	std::fill(gridData, gridData + Cells(), OpCode::None);
 }
 
-Grid::Grid(const Grid& other) : width(other.width), height(other.height), gridData(new int[other.width * other.height]), cursors(other.cursors)
+Grid::Grid(const Grid& other) : width(other.width), height(other.height), widthMask(other.widthMask), heightMask(other.heightMask), layout(other.layout), blockColumns(other.blockColumns), gridData(new int[other.Cells()]), mapping(nullptr), cursors(other.cursors), cursorsToAdd(other.cursorsToAdd), timing(other.timing), counters(other.counters), limits(other.limits), stepThreshold(other.stepThreshold), writeThreshold(other.writeThreshold), clockThreshold(other.clockThreshold), deadline(other.deadline), stopReason(other.stopReason)
 {
-	std::copy(other.gridData, other.gridData + other.width * other.height, gridData);
+	std::copy(other.gridData, other.gridData + other.Cells(), gridData);
 }
 Grid::Grid(Grid&& other) noexcept : Grid()
 {
@@ -511,20 +412,28 @@ Grid& Grid::operator=(Grid&& other) noexcept
 
 Grid::~Grid()
 {
-	delete[] gridData;
+	if (mapping)
+	{
+		delete mapping;
+		mapping = nullptr;
+	}
+	else
+	{
+		delete[] gridData;
+	}
 	gridData = nullptr;
 }
 
 int& Grid::operator()(int x, int y)
 {
 	assert(x >= 0 && y >= 0 && x < width && y < height);
-	return gridData[x + y * width];
+	return gridData[Index(x, y)];
 }
 
 int Grid::operator()(int x, int y) const
 {
 	assert(x >= 0 && y >= 0 && x < width && y < height);
-	return gridData[x + y * width];
+	return gridData[Index(x, y)];
 }
 
 int& Grid::operator()(Selection selection, bool previous)
@@ -550,36 +459,253 @@ Grid::ConstView Grid::operator()(WSelection selection, bool previous) const
 int Grid::Width() const { return width; }
 int Grid::Height() const { return height; }
 
-void Grid::Print() const
+size_t Grid::Cells() const
 {
-	SetColor(MakeColor(0xFF, 0xFF, 0xFF, 0xFF));
-	Layer(0);
-	for (int i = 0; i < width; i++)
+	return size_t(Cells(width, height, layout));
+}
+
+uint64_t Grid::Cells(int width, int height, GridLayout layout)
+{
+	// in 64 bits, so the count of a grid too large to allocate cannot wrap around to a small one
+	if (layout == GridLayout::Blocked)
+	{
+		// whole blocks only
+		return ((uint64_t(width) + 3) / 4) * ((uint64_t(height) + 3) / 4) * 16;
+	}
+	return uint64_t(width) * uint64_t(height);
+}
+
+template <typename Visitor>
+void Grid::ForEachCell(Visitor visit) const
+{
+	if (layout == GridLayout::Blocked)
+	{
+		for (int by = 0; by < height; by += 4)
+		{
+			for (int bx = 0; bx < width; bx += 4)
+			{
+				const int* block = gridData + Index(bx, by);
+				for (int j = 0; j < 4 && by + j < height; j++)
+				{
+					for (int i = 0; i < 4 && bx + i < width; i++)
+					{
+						visit(bx + i, by + j, block[j * 4 + i]);
+					}
+				}
+			}
+		}
+	}
+	else
 	{
 		for (int j = 0; j < height; j++)
 		{
-			Put(i, j, (*this)(i, j));
+			for (int i = 0; i < width; i++)
+			{
+				visit(i, j, gridData[Index(i, j)]);
+			}
 		}
 	}
+}
 
-	Layer(1);
-	for (const Cursor& cursor : cursors)
+GridLayout Grid::Layout() const { return layout; }
+
+bool Grid::SetLayout(GridLayout layout)
+{
+	if (layout == this->layout) { return true; }
+	if (mapping) { return false; }
+
+	Grid relaid(width, height, layout);
+	ForEachCell([&relaid](int x, int y, int cell) { relaid(x, y) = cell; });
+	std::swap(gridData, relaid.gridData);
+	std::swap(this->layout, relaid.layout);
+	std::swap(blockColumns, relaid.blockColumns);
+	return true;
+}
+
+bool Grid::MapFile(const std::string& path)
+{
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	int w = width;
+	int h = height;
+	GridLayout l = layout;
+	size_t headerSize = sizeof(MappedGridHeader);
+	bool adopted = false;
+
+	if (file->Open(path))
 	{
-		cursor.Print(*this);
+		// existing file, adopt its contents
+		if (file->Size() < mappedGridHeaderSizeV1) { return false; }
+
+		MappedGridHeader header = { };
+		std::memcpy(&header, file->Data(), std::min(file->Size(), sizeof(header)));
+		if (std::memcmp(header.magic, mappedGridMagic, sizeof(header.magic)) != 0) { return false; }
+
+		if (header.version == 1)
+		{
+			headerSize = mappedGridHeaderSizeV1;
+			header.layout = static_cast<int32_t>(GridLayout::RowMajor);
+		}
+		else if (header.version != mappedGridVersion || file->Size() < sizeof(header))
+		{
+			return false;
+		}
+
+		if (header.width <= 0 || header.height <= 0 ||
+			(header.layout != static_cast<int32_t>(GridLayout::RowMajor) && header.layout != static_cast<int32_t>(GridLayout::Blocked)))
+		{
+			return false;
+		}
+
+		w = header.width;
+		h = header.height;
+		l = static_cast<GridLayout>(header.layout);
+		if (file->Size() != headerSize + Cells(w, h, l) * sizeof(int)) { return false; }
+
+		adopted = true;
+	}
+	else
+	{
+		// new file, fill it from this grid
+		if (!gridData || !file->Open(path, headerSize + Cells() * sizeof(int))) { return false; }
+
+		MappedGridHeader header = { };
+		std::memcpy(header.magic, mappedGridMagic, sizeof(header.magic));
+		header.version = mappedGridVersion;
+		header.width = width;
+		header.height = height;
+		header.layout = static_cast<int32_t>(layout);
+		std::memcpy(file->Data(), &header, sizeof(header));
+		std::memcpy(static_cast<char*>(file->Data()) + headerSize, gridData, Cells() * sizeof(int));
+	}
+
+	if (mapping)
+	{
+		delete mapping;
 	}
+	else
+	{
+		delete[] gridData;
+	}
+
+	mapping = file.release();
+	gridData = reinterpret_cast<int*>(static_cast<char*>(mapping->Data()) + headerSize);
+	width = w;
+	height = h;
+	widthMask = WrapMask(w);
+	heightMask = WrapMask(h);
+	layout = l;
+	blockColumns = BlockColumns(w, l);
+	if (adopted)
+	{
+		// cursors belonged to the old cells
+		cursors.clear();
+		cursorsToAdd.clear();
+	}
+
+	return true;
 }
 
-bool Grid::Update()
+bool Grid::IsMapped() const { return mapping != nullptr; }
+
+int Grid::WrapX(int x) const
+{
+	return widthMask >= 0 ? x & widthMask : Wrap(x, width);
+}
+
+int Grid::WrapY(int y) const
 {
-	for (int i = cursors.size() - 1; i >= 0; i--)
+	return heightMask >= 0 ? y & heightMask : Wrap(y, height);
+}
+
+const std::vector<Cursor>& Grid::Cursors() const { return cursors; }
+const std::vector<Cursor>& Grid::QueuedCursors() const { return cursorsToAdd; }
+
+const GridCounters& Grid::Counters() const { return counters; }
+void Grid::ResetCounters()
+{
+	counters = GridCounters();
+	if (limits.timeLimit.count() > 0) { clockThreshold = 0; }
+}
+void Grid::SetTiming(bool enabled) { timing = enabled; }
+
+const GridLimits& Grid::Limits() const { return limits; }
+
+void Grid::SetLimits(const GridLimits& limits)
+{
+	this->limits = limits;
+	stepThreshold = limits.maxSteps > 0 ? limits.maxSteps : UINT64_MAX;
+	writeThreshold = limits.maxWrites > 0 ? limits.maxWrites : UINT64_MAX;
+	clockThreshold = limits.timeLimit.count() > 0 ? 0 : UINT64_MAX;
+	deadline = std::chrono::steady_clock::now() + limits.timeLimit;
+	stopReason = GridStatus::Running;
+
+	// a grid already past a limit stops before its next step
+	CheckLimits();
+}
+
+GridStatus Grid::Status() const
+{
+	if (cursors.empty() && cursorsToAdd.empty()) { return GridStatus::Finished; }
+	return stopReason;
+}
+
+bool Grid::CheckLimits()
+{
+	if (stopReason != GridStatus::Running) { return false; }
+	// a finished program is not stopped by a limit, even on the step that reached it
+	if (cursors.empty() && cursorsToAdd.empty()) { return true; }
+
+	if (counters.steps >= stepThreshold)
+	{
+		stopReason = GridStatus::StepLimit;
+	}
+	else if (limits.maxCursors > 0 && cursors.size() > limits.maxCursors)
 	{
-		if (!cursors[i].Update(*this))
+		stopReason = GridStatus::CursorLimit;
+	}
+	else if (counters.writes > writeThreshold)
+	{
+		stopReason = GridStatus::WriteLimit;
+	}
+	else if (counters.executions + counters.writes >= clockThreshold)
+	{
+		// instructions and writes stand in for elapsed time, so the clock is read about every 16k of them rather than every step
+		clockThreshold = counters.executions + counters.writes + (1 << 14);
+		if (std::chrono::steady_clock::now() >= deadline)
 		{
-			cursors.erase(cursors.begin() + i);
+			stopReason = GridStatus::TimeLimit;
 		}
 	}
 
-	return cursors.size() > 0;
+	return stopReason == GridStatus::Running;
+}
+
+void Grid::Print() const
+{
+	const bool timed = timing;
+	std::chrono::steady_clock::time_point start;
+	if (timed) { start = std::chrono::steady_clock::now(); }
+
+	SetColor(MakeColor(0xFF, 0xFF, 0xFF, 0xFF));
+	Layer(0);
+	ForEachCell([](int x, int y, int cell) { Put(x, y, cell); });
+
+	Layer(1);
+	for (const Cursor& cursor : cursors)
+	{
+		cursor.Print(*this);
+	}
+
+	if (timed)
+	{
+		counters.printNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+bool Grid::Update()
+{
+	NullHooks hooks;
+	return Update(hooks);
 }
 
 void Grid::QueueAddCursor(int ipX, int ipY, int selX, int selY)
@@ -592,8 +718,54 @@ void Grid::QueueAddCursor(const Cursor& cursor)
 	cursorsToAdd.push_back(cursor);
 }
 
+bool Grid::QueueStartCursor()
+{
+	int ipStartX = -1;
+	int ipStartY = -1;
+	int selStartX = -1;
+	int selStartY = -1;
+	// if there are several of a marker, use the last one in column-major order, whatever the memory order
+	auto later = [](int x, int y, int otherX, int otherY) { return x > otherX || (x == otherX && y > otherY); };
+	ForEachCell([&](int x, int y, int cell)
+	{
+		switch (cell)
+		{
+		case OpCode::IPStart:
+			if (later(x, y, ipStartX, ipStartY))
+			{
+				ipStartX = x;
+				ipStartY = y;
+			}
+			break;
+
+		case OpCode::SelectionStart:
+			if (later(x, y, selStartX, selStartY))
+			{
+				selStartX = x;
+				selStartY = y;
+			}
+			break;
+		}
+	});
+
+	if (ipStartX >= 0 && ipStartY >= 0 && selStartX >= 0 && selStartY >= 0)
+	{
+		QueueAddCursor(ipStartX, ipStartY, selStartX, selStartY);
+		return true;
+	}
+
+	return false;
+}
+
 void Grid::AddCursors()
 {
+	if (limits.maxCursors > 0 && cursors.size() + cursorsToAdd.size() > limits.maxCursors)
+	{
+		// leave the queue in place, so the stopped grid still holds every cursor
+		if (stopReason == GridStatus::Running) { stopReason = GridStatus::CursorLimit; }
+		return;
+	}
+
 	while (!cursorsToAdd.empty())
 	{
 		cursors.push_back(cursorsToAdd.back());
@@ -611,18 +783,40 @@ Grid::View::View(Grid* grid, int x, int y, int width) : grid(grid), x(x), y(y),
 int& Grid::View::operator()(int offset)
 {
 	assert(offset >= 0 && offset < width);
-	return (*grid)((x + offset) % grid->Width(), y);
+	return (*grid)(X(offset), y);
 }
 int Grid::View::operator()(int offset) const
 {
 	assert(offset >= 0 && offset < width);
-	return (*grid)((x + offset) % grid->Width(), y);
+	return (*grid)(X(offset), y);
 }
 
+int Grid::View::X(int offset) const
+{
+	// x is on the grid, so an offset less than the grid width needs at most one wrap.
+	// a cursor can be built with a selection wider than its grid, which needs the full wrap
+	int i = x + offset;
+	if (i < grid->Width()) { return i; }
+	i -= grid->Width();
+	return i < grid->Width() ? i : grid->WrapX(i);
+}
+int Grid::View::Y() const { return y; }
+
 Grid::ConstView::ConstView(const Grid* grid, int x, int y, int width) : grid(grid), x(x), y(y), width(width) { }
 
 int Grid::ConstView::operator()(int offset) const
 {
 	assert(offset >= 0 && offset < width);
-	return (*grid)((x + offset) % grid->Width(), y);
-}
\ No newline at end of file
+	return (*grid)(X(offset), y);
+}
+
+int Grid::ConstView::X(int offset) const
+{
+	// x is on the grid, so an offset less than the grid width needs at most one wrap.
+	// a cursor can be built with a selection wider than its grid, which needs the full wrap
+	int i = x + offset;
+	if (i < grid->Width()) { return i; }
+	i -= grid->Width();
+	return i < grid->Width() ? i : grid->WrapX(i);
+}
+int Grid::ConstView::Y() const { return y; }
\ No newline at end of file
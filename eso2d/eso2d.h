@@ -1,8 +1,10 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <vector>
 #include <iostream>
+#include <string>
 
 /// <summary>
 /// Print code into the terminal at (x, y).
@@ -45,8 +47,8 @@ namespace OpCode
 		Widen = 'w', // widen selection cursor
 		Shrink = 's', // shrink selection cursor
 		Move = 'm', // copy data under selection from old selection position to current selection position
-		Increment = '+', // increment number under selection
-		Decrement = '-', // decrement number under selection
+		Increment = '+', // increment number under selection. exact for any width, all 9s wrap to all 0s
+		Decrement = '-', // decrement number under selection. exact for any width, zero stays zero
 		// move ip forward and set all of the selection to ip
 		// optionally precede with LeftIndicator or RightIndicator to only set the left or right side of the selection
 		Set = '=',
@@ -75,6 +77,10 @@ class Selection
 	bool wrappedX;
 	bool wrappedY;
 
+	friend class ReferenceEngine;
+	friend class ThreadedStepper;
+	friend class Checkpoint;
+
 public:
 	Selection();
 	Selection(int x, int y);
@@ -92,12 +98,18 @@ public:
 
 	void SetPosition(int x, int y, const class Grid&);
 	void MoveBy(int dx, int dy, const class Grid&);
+
+	bool operator==(const Selection& other) const;
+	bool operator!=(const Selection& other) const;
 };
 
 class WSelection : public Selection
 {
 	int width;
 
+	friend class ReferenceEngine;
+	friend class Checkpoint;
+
 public:
 	WSelection();
 	WSelection(int x, int y, int w);
@@ -108,10 +120,64 @@ public:
 
 	void Widen(const class Grid&);
 	void Shrink(const class Grid&);
+
+	bool operator==(const WSelection& other) const;
+	bool operator!=(const WSelection& other) const;
+};
+
+/// <summary>
+/// Hook policy that ignores every event.
+/// Passing this (or nothing) to Update compiles down to the plain interpreter.
+/// </summary>
+struct NullHooks
+{
+	/// <summary>
+	/// Called at the start of every grid step, before any cursor executes.
+	/// </summary>
+	/// <param name="grid">Grid about to be stepped.</param>
+	void OnStep(const class Grid&) { }
+	/// <summary>
+	/// Called before a cursor executes the instruction under its ip.
+	/// After a side indicator, called again for the instruction it applies to, which runs in the same step.
+	/// </summary>
+	/// <param name="grid">Grid containing the code.</param>
+	/// <param name="cursor">Cursor about to execute.</param>
+	/// <param name="instruction">Instruction under the cursor's ip.</param>
+	void OnExecute(const class Grid&, const class Cursor&, int) { }
+	/// <summary>
+	/// Called before a cursor writes to a cell.
+	/// </summary>
+	/// <param name="grid">Grid being written to.</param>
+	/// <param name="x">X position of the cell.</param>
+	/// <param name="y">Y position of the cell.</param>
+	/// <param name="oldValue">Value currently in the cell.</param>
+	/// <param name="newValue">Value about to be written.</param>
+	void OnWrite(const class Grid&, int, int, int, int) { }
+	/// <summary>
+	/// Called when a cursor splits at a '%'.
+	/// </summary>
+	/// <param name="grid">Grid containing the code.</param>
+	/// <param name="parent">Cursor that executed the split.</param>
+	/// <param name="child">Cursor about to be queued.</param>
+	void OnSpawn(const class Grid&, const class Cursor&, const class Cursor&) { }
+	/// <summary>
+	/// Called when a cursor dies, either at a '#' or at an invalid instruction.
+	/// </summary>
+	/// <param name="grid">Grid containing the code.</param>
+	/// <param name="cursor">Cursor that is about to be removed.</param>
+	void OnDeath(const class Grid&, const class Cursor&) { }
 };
 
 class Cursor
 {
+	enum class Side
+	{
+		None,
+		Left,
+		All,
+		Right
+	};
+
 	Selection ip;
 	WSelection selected;
 
@@ -121,12 +187,44 @@ class Cursor
 	void Move(class Grid&);
 	void TurnLeft();
 	void TurnRight();
+	// compare the whole selection against the cell after the ip, and turn
+	void Conditional(const class Grid&);
+	// compare one side of the selection against the cell after the ip, turn and move
+	void SideConditional(class Grid&, Side side);
+
+	template <typename Hooks>
+	void Write(class Grid& grid, Hooks& hooks, int offset, int value);
+	// copy the selection's previous cells to its current cells
+	template <typename Hooks>
+	void MoveCells(class Grid& grid, Hooks& hooks);
+	// add one (amount 1) or take one (amount -1) from the number under the selection. taking one from zero leaves zero. does nothing if it is not a number
+	template <typename Hooks>
+	void Add(class Grid& grid, Hooks& hooks, int amount);
+	// set the whole selection to the cell after the ip
+	template <typename Hooks>
+	void SetAll(class Grid& grid, Hooks& hooks);
+	// set one side of the selection to the cell after the ip, and move
+	template <typename Hooks>
+	void SetSide(class Grid& grid, Hooks& hooks, Side side);
+
+	friend class ReferenceEngine;
+	friend class BatchedStepper;
+	friend class ThreadedStepper;
+	friend class Checkpoint;
 
 public:
 	Cursor();
 	Cursor(int ipx, int ipy, int sx, int sy);
 	Cursor(int ipx, int ipy, int sx, int sy, int sw, int dx, int dy);
 
+	const Selection& IP() const;
+	const WSelection& Selected() const;
+	int DX() const;
+	int DY() const;
+
+	bool operator==(const Cursor& other) const;
+	bool operator!=(const Cursor& other) const;
+
 	/// <summary>
 	/// Print the cursor to the terminal.
 	/// </summary>
@@ -139,17 +237,121 @@ public:
 	/// <param name="grid">Grid containing the code.</param>
 	/// <returns>True if the cursor is still alive, false otherwise.</returns>
 	bool Update(class Grid& grid);
+	/// <summary>
+	/// Execute one instruction, reporting events to hooks.
+	/// </summary>
+	/// <param name="grid">Grid containing the code.</param>
+	/// <param name="hooks">Hook policy receiving write, spawn and death events. See NullHooks.</param>
+	/// <returns>True if the cursor is still alive, false otherwise.</returns>
+	template <typename Hooks>
+	bool Update(class Grid& grid, Hooks& hooks);
+};
+
+/// <summary>
+/// How a grid's cells are ordered in memory. Only affects speed; every accessor and file format sees the same cells.
+/// </summary>
+enum class GridLayout
+{
+	RowMajor, // cells in rows, left to right
+	Blocked // 4x4 blocks of one cache line each, so vertical moves usually stay in the same line. blocks are in rows
+};
+
+/// <summary>
+/// Running totals kept by every grid. Counts are always kept, times only while timing is enabled.
+/// </summary>
+struct GridCounters
+{
+	uint64_t steps; // completed Update calls
+	uint64_t executions; // instructions executed, summed over all cursors
+	uint64_t writes; // cells written by cursors
+	uint64_t updateNanoseconds; // time spent in Update
+	uint64_t printNanoseconds; // time spent in Print
+};
+
+/// <summary>
+/// Per-run limits for programs that cannot be trusted to stop. Zero means no limit.
+/// Limits are checked between steps, never inside one, so a stopped grid is always in a state Update could have left it in.
+/// </summary>
+struct GridLimits
+{
+	uint64_t maxSteps; // steps, as counted by Counters()
+	size_t maxCursors; // live cursors. checked as queued cursors are added
+	uint64_t maxWrites; // cells written, as counted by Counters(). the last step may write past it
+	std::chrono::milliseconds timeLimit; // wall-clock time from SetLimits. the clock is read every few thousand instructions
+};
+
+/// <summary>
+/// Whether a grid is still running, and if not, why.
+/// </summary>
+enum class GridStatus
+{
+	Running, // cursors are alive or queued, and no limit has been reached
+	Finished, // every cursor has died
+	StepLimit,
+	CursorLimit,
+	WriteLimit,
+	TimeLimit
 };
 
 class Grid
 {
 	int width;
 	int height;
+	// width - 1 / height - 1 when that dimension is a power of two, -1 otherwise
+	int widthMask;
+	int heightMask;
+	GridLayout layout;
+	// number of 4x4 blocks in a row, for GridLayout::Blocked
+	int blockColumns;
 	int* gridData;
+	// set if gridData points into a memory-mapped file rather than a heap allocation
+	class MappedFile* mapping;
 
 	std::vector<Cursor> cursors;
 	std::vector<Cursor> cursorsToAdd;
 
+	bool timing;
+	mutable GridCounters counters;
+
+	GridLimits limits;
+	// limits as thresholds, UINT64_MAX where there is no limit, so a step within every limit costs three comparisons
+	uint64_t stepThreshold;
+	uint64_t writeThreshold;
+	// executions plus writes at which to next read the clock
+	uint64_t clockThreshold;
+	std::chrono::steady_clock::time_point deadline;
+	// limit that stopped the grid, or Running
+	GridStatus stopReason;
+
+	// true if the grid may step. every engine calls this before a step
+	bool BeginStep() const { return stopReason == GridStatus::Running; }
+	// count a finished step. every engine calls this after a step. false if a limit was reached
+	bool EndStep()
+	{
+		counters.steps++;
+		if (counters.steps < stepThreshold && counters.writes <= writeThreshold &&
+			counters.executions + counters.writes < clockThreshold)
+		{
+			return true;
+		}
+		return CheckLimits();
+	}
+	// record the first limit reached, if any. true if none has been
+	bool CheckLimits();
+
+	// position of a cell in gridData
+	int Index(int x, int y) const
+	{
+		return layout == GridLayout::Blocked ?
+			(((y >> 2) * blockColumns + (x >> 2)) << 4) + ((y & 3) << 2) + (x & 3) :
+			x + y * width;
+	}
+	// length of gridData, including any padding the layout needs
+	size_t Cells() const;
+	// call visit(x, y, cell) for every cell, in memory order
+	template <typename Visitor>
+	void ForEachCell(Visitor visit) const;
+
 	class View
 	{
 	public:
@@ -158,6 +360,9 @@ class Grid
 		int& operator()(int offset);
 		int operator()(int offset) const;
 
+		int X(int offset) const;
+		int Y() const;
+
 	private:
 		Grid* grid;
 		int x;
@@ -172,6 +377,9 @@ class Grid
 
 		int operator()(int offset) const;
 
+		int X(int offset) const;
+		int Y() const;
+
 	private:
 		const Grid* grid;
 		int x;
@@ -181,12 +389,20 @@ class Grid
 
 	Grid();
 
+	friend class Cursor;
+	friend class ReferenceEngine;
+	friend class BatchedStepper;
+	friend class ThreadedStepper;
+	friend class Checkpoint;
+	friend class StatePublisher;
+	friend class StateReader;
+
 public:
 	friend void swap(Grid& first, Grid& second) noexcept;
 	friend std::ostream& operator<<(std::ostream& out, const Grid& grid);
 	friend std::istream& operator>>(std::istream& in, Grid& grid);
 
-	Grid(int w, int h);
+	Grid(int w, int h, GridLayout layout = GridLayout::RowMajor);
 
 	Grid(const Grid&);
 	Grid(Grid&&) noexcept;
@@ -206,14 +422,311 @@ public:
 	int Width() const;
 	int Height() const;
 
+	GridLayout Layout() const;
+	/// <summary>
+	/// Number of cells stored for a grid of this size and layout, including any padding the layout needs.
+	/// </summary>
+	/// <param name="width">Grid width, greater than zero.</param>
+	/// <param name="height">Grid height, greater than zero.</param>
+	/// <param name="layout">Grid layout.</param>
+	/// <returns>The count, in 64 bits so a size too large to allocate cannot wrap around to a small one.</returns>
+	static uint64_t Cells(int width, int height, GridLayout layout);
+	/// <summary>
+	/// Reorder the cells in memory. Cursors and cell values are unchanged.
+	/// </summary>
+	/// <param name="layout">New layout.</param>
+	/// <returns>True if the grid now has the layout, false if it is mapped, as the file would also need rewriting.</returns>
+	bool SetLayout(GridLayout layout);
+
+	/// <summary>
+	/// Move the cells into a memory-mapped file, so every later write persists with no explicit save.
+	/// If the file already holds a mapped grid, that grid's size, layout and cells replace this grid's, without reading the file up front.
+	/// Otherwise the file is created from this grid's cells, in this grid's layout.
+	/// Copies of a mapped grid are ordinary in-memory grids.
+	/// </summary>
+	/// <param name="path">File to map.</param>
+	/// <returns>True if the grid is now mapped, false if the file could not be mapped or is not a mapped grid. The grid is unchanged on failure.</returns>
+	bool MapFile(const std::string& path);
+	bool IsMapped() const;
+
+	/// <summary>
+	/// Wrap an x position onto the grid. Uses a mask instead of a division if the width is a power of two.
+	/// </summary>
+	/// <param name="x">X position, possibly off the grid.</param>
+	/// <returns>The equivalent x position in [0, Width()).</returns>
+	int WrapX(int x) const;
+	/// <summary>
+	/// Wrap a y position onto the grid. Uses a mask instead of a division if the height is a power of two.
+	/// </summary>
+	/// <param name="y">Y position, possibly off the grid.</param>
+	/// <returns>The equivalent y position in [0, Height()).</returns>
+	int WrapY(int y) const;
+
+	const std::vector<Cursor>& Cursors() const;
+	/// <summary>
+	/// Cursors queued by splits but not yet added. Left in place when adding them would pass the cursor limit.
+	/// </summary>
+	const std::vector<Cursor>& QueuedCursors() const;
+
+	const GridCounters& Counters() const;
+	void ResetCounters();
+	/// <summary>
+	/// Measure time spent in Update and Print. Off by default, as it reads the clock twice per call.
+	/// </summary>
+	/// <param name="enabled">Whether to measure time.</param>
+	void SetTiming(bool enabled);
+
+	const GridLimits& Limits() const;
+	/// <summary>
+	/// Limit how far the grid may run. Update returns false once a limit is reached, leaving the cells, cursors, queued cursors and counters as they were after the last step.
+	/// Checking costs a few comparisons per step, and nothing per instruction beyond counting writes.
+	/// Clears any earlier limit status, and starts the time limit from now.
+	/// </summary>
+	/// <param name="limits">New limits. Steps and writes are compared against Counters(), so reset them first to limit a fresh run.</param>
+	void SetLimits(const GridLimits& limits);
+	/// <summary>
+	/// Whether the grid is still running. A limit takes precedence over Running, but not over Finished.
+	/// </summary>
+	GridStatus Status() const;
+
 	void Print() const;
 
 	bool Update();
+	template <typename Hooks>
+	bool Update(Hooks& hooks);
 
 	void QueueAddCursor(int ipx, int ipy, int sx, int sy);
 	void QueueAddCursor(const Cursor& cursor);
+	/// <summary>
+	/// Queue a cursor at the program's IPStart and SelectionStart cells.
+	/// </summary>
+	/// <returns>True if both start cells were found and a cursor was queued, false otherwise.</returns>
+	bool QueueStartCursor();
 
+	/// <summary>
+	/// Add the queued cursors. If that would pass the cursor limit, none are added and the grid stops with GridStatus::CursorLimit.
+	/// </summary>
 	void AddCursors();
 
 	void Stop();
-};
\ No newline at end of file
+};
+
+template <typename Hooks>
+void Cursor::Write(Grid& grid, Hooks& hooks, int offset, int value)
+{
+	auto view = grid(selected);
+	int& cell = view(offset);
+	hooks.OnWrite(grid, view.X(offset), view.Y(), cell, value);
+	cell = value;
+	grid.counters.writes++;
+}
+
+template <typename Hooks>
+void Cursor::MoveCells(Grid& grid, Hooks& hooks)
+{
+	if (selected.MovedRight())
+	{
+		// moving right, iterate from right-to-left
+		for (int i = selected.Width() - 1; i >= 0; i--)
+		{
+			Write(grid, hooks, i, grid(selected, true)(i));
+		}
+	}
+	else if (selected.MovedLeft() || selected.Y() != selected.PreviousY())
+	{
+		// moving left, iterate from left-to-right
+		// moving up or down, iteration order doesn't matter, memory will not overlap
+		for (int i = 0; i < selected.Width(); i++)
+		{
+			Write(grid, hooks, i, grid(selected, true)(i));
+		}
+	}
+}
+
+template <typename Hooks>
+void Cursor::Add(Grid& grid, Hooks& hooks, int amount)
+{
+	// do nothing if not a valid number
+	for (int i = 0; i < selected.Width(); i++)
+	{
+		const int gridValue = grid(selected)(i);
+		if (gridValue < '0' || gridValue > '9') { return; }
+	}
+
+	// work digit by digit, so a selection of any width is exact.
+	// adding one turns trailing 9s into 0s and raises the next digit, dropping a carry out of the leftmost digit.
+	// taking one turns trailing 0s into 9s and lowers the next digit
+	const int trailing = amount > 0 ? '9' : '0';
+	int changed = selected.Width() - 1;
+	while (changed >= 0 && grid(selected)(changed) == trailing) { changed--; }
+	// no negative number support in this esolang, so zero minus one stays zero
+	const bool clamped = amount < 0 && changed < 0;
+
+	// every digit is written, changed or not, as the original did
+	for (int i = selected.Width() - 1; i >= 0; i--)
+	{
+		int digit = grid(selected)(i);
+		if (!clamped && i > changed) { digit = amount > 0 ? '0' : '9'; }
+		else if (!clamped && i == changed) { digit += amount; }
+		Write(grid, hooks, i, digit);
+	}
+}
+
+template <typename Hooks>
+void Cursor::SetAll(Grid& grid, Hooks& hooks)
+{
+	ip.MoveBy(dx, dy, grid);
+	for (int i = 0; i < selected.Width(); i++)
+	{
+		Write(grid, hooks, i, grid(ip));
+	}
+}
+
+template <typename Hooks>
+void Cursor::SetSide(Grid& grid, Hooks& hooks, Side side)
+{
+	ip.MoveBy(dx, dy, grid);
+	Write(grid, hooks, side == Side::Left ? 0 : selected.Width() - 1, grid(ip));
+	Move(grid);
+}
+
+template <typename Hooks>
+bool Cursor::Update(Grid& grid, Hooks& hooks)
+{
+	int instruction = grid(ip);
+	Side side = Side::None;
+
+	hooks.OnExecute(grid, *this, instruction);
+
+	switch (instruction)
+	{
+	case OpCode::IPStart:
+	case OpCode::Path:
+		break;
+
+	case OpCode::Skip:
+		ip.MoveBy(dx, dy, grid);
+		break;
+
+	case OpCode::Left:
+		selected.MoveBy(-1, 0, grid);
+		break;
+
+	case OpCode::Right:
+		selected.MoveBy(1, 0, grid);
+		break;
+
+	case OpCode::Up:
+		selected.MoveBy(0, -1, grid);
+		break;
+
+	case OpCode::Down:
+		selected.MoveBy(0, 1, grid);
+		break;
+
+	case OpCode::Widen:
+		selected.Widen(grid);
+		break;
+
+	case OpCode::Shrink:
+		selected.Shrink(grid);
+		break;
+
+	case OpCode::Move:
+		MoveCells(grid, hooks);
+		break;
+
+	case OpCode::Increment:
+		Add(grid, hooks, 1);
+		break;
+
+	case OpCode::Decrement:
+		Add(grid, hooks, -1);
+		break;
+
+	case OpCode::Set:
+		SetAll(grid, hooks);
+		break;
+
+	case OpCode::Conditional:
+		Conditional(grid);
+		break;
+
+	case OpCode::Split:
+	{
+		Cursor other(*this);
+		other.TurnLeft();
+		other.Move(grid);
+		TurnRight();
+		hooks.OnSpawn(grid, *this, other);
+		grid.QueueAddCursor(other);
+		break;
+	}
+
+	case OpCode::LeftIndicator:
+		side = Side::Left;
+		break;
+
+	case OpCode::RightIndicator:
+		side = Side::Right;
+		break;
+
+	default: // OpCode::Terminate is also covered here
+		hooks.OnDeath(grid, *this);
+		return false;
+	}
+
+	Move(grid);
+
+	if (side != Side::None)
+	{
+		// the indicated instruction runs in this step too, so it is reported like any other
+		hooks.OnExecute(grid, *this, grid(ip));
+
+		switch (grid(ip))
+		{
+		case OpCode::Conditional:
+			SideConditional(grid, side);
+			break;
+
+		case OpCode::Set:
+			SetSide(grid, hooks, side);
+			break;
+
+		default:
+			hooks.OnDeath(grid, *this);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template <typename Hooks>
+bool Grid::Update(Hooks& hooks)
+{
+	if (!BeginStep()) { return false; }
+
+	const bool timed = timing;
+	std::chrono::steady_clock::time_point start;
+	if (timed) { start = std::chrono::steady_clock::now(); }
+
+	hooks.OnStep(*this);
+
+	counters.executions += cursors.size();
+	for (int i = cursors.size() - 1; i >= 0; i--)
+	{
+		if (!cursors[i].Update(*this, hooks))
+		{
+			cursors.erase(cursors.begin() + i);
+		}
+	}
+	const bool withinLimits = EndStep();
+
+	if (timed)
+	{
+		counters.updateNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	return withinLimits && cursors.size() > 0;
+}
@@ -0,0 +1,138 @@
+#include "journal.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+// each record is x, y and the new value as native 32-bit integers.
+// a torn record at the end of the file (from a crash mid-write) is ignored.
+struct JournalRecord
+{
+	int32_t x;
+	int32_t y;
+	int32_t value;
+};
+
+static bool ReplaceFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// cut a file down to size bytes
+static bool TruncateFile(const std::string& path, uint64_t size)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) { return false; }
+	LARGE_INTEGER end;
+	end.QuadPart = static_cast<LONGLONG>(size);
+	const bool truncated = SetFilePointerEx(file, end, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+	CloseHandle(file);
+	return truncated;
+#else
+	return truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+Journal::Journal(const std::string& snapshotPath, const std::string& journalPath, size_t compactAfter) :
+	snapshotPath(snapshotPath), journalPath(journalPath), compactAfter(compactAfter), records(0), compactAt(compactAfter) { }
+
+size_t Journal::Load(Grid& grid)
+{
+	{
+		std::ifstream snapshot(snapshotPath, std::ios_base::binary);
+		if (snapshot)
+		{
+			snapshot >> grid;
+		}
+	}
+
+	records = 0;
+	compactAt = compactAfter;
+	bool torn = false;
+	{
+		std::ifstream in(journalPath, std::ios_base::binary);
+		JournalRecord record;
+		while (in.read(reinterpret_cast<char*>(&record), sizeof(record)))
+		{
+			if (record.x >= 0 && record.y >= 0 && record.x < grid.Width() && record.y < grid.Height())
+			{
+				grid(record.x, record.y) = record.value;
+			}
+			records++;
+		}
+		torn = in.gcount() > 0;
+	}
+	const size_t replayed = records;
+
+	out.close();
+	// appending after a torn record would misalign every later one, so cut it off first.
+	// if that fails, a fresh snapshot makes the whole journal unnecessary. if that fails too, nothing is appended until a later compact succeeds
+	if (torn && !TruncateFile(journalPath, uint64_t(records) * sizeof(JournalRecord)))
+	{
+		Compact(grid);
+		return replayed;
+	}
+	out.open(journalPath, std::ios_base::binary | std::ios_base::app);
+	return replayed;
+}
+
+void Journal::Record(const Grid& grid, int x, int y)
+{
+	JournalRecord record = { x, y, grid(x, y) };
+	out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	out.flush();
+	records++;
+
+	if (records >= compactAt && !Compact(grid))
+	{
+		compactAt = records + compactAfter;
+	}
+}
+
+bool Journal::Compact(const Grid& grid)
+{
+	// write the new snapshot beside the old one and swap it in, so a crash at any point leaves a usable pair.
+	// replaying the old journal over the new snapshot is harmless, every edit in it is already included.
+	const std::string temporaryPath = snapshotPath + ".tmp";
+	{
+		std::ofstream snapshot(temporaryPath, std::ios_base::binary | std::ios_base::trunc);
+		snapshot << grid;
+		snapshot.flush();
+		if (!snapshot) { return false; }
+	}
+
+	if (!ReplaceFile(temporaryPath, snapshotPath)) { return false; }
+
+	out.close();
+	out.open(journalPath, std::ios_base::binary | std::ios_base::trunc);
+	records = 0;
+	compactAt = compactAfter;
+	return true;
+}
+
+bool Journal::Discard()
+{
+	// close first, an open file cannot be deleted on windows
+	out.close();
+	records = 0;
+	compactAt = compactAfter;
+
+	// a file that was never written counts as discarded
+	const bool snapshotGone = std::remove(snapshotPath.c_str()) == 0 || !std::ifstream(snapshotPath);
+	const bool journalGone = std::remove(journalPath.c_str()) == 0 || !std::ifstream(journalPath);
+	return snapshotGone && journalGone;
+}
+
+size_t Journal::Size() const { return records; }
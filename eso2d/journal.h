@@ -0,0 +1,66 @@
+#pragma once
+
+#include "eso2d.h"
+
+#include <fstream>
+#include <string>
+
+/// <summary>
+/// Persists editor changes as an append-only journal next to a text snapshot of the grid.
+/// Each edit costs one small append, and the journal is folded into a fresh snapshot once it grows past a threshold.
+/// After a crash, loading the snapshot and replaying the journal recovers every recorded edit.
+/// </summary>
+class Journal
+{
+public:
+	/// <summary>
+	/// Create a journal. Nothing is read or written until Load.
+	/// </summary>
+	/// <param name="snapshotPath">Text snapshot, in the same format as operator&lt;&lt;.</param>
+	/// <param name="journalPath">Append-only file of edits made since the snapshot.</param>
+	/// <param name="compactAfter">Number of edits after which Record compacts automatically.</param>
+	Journal(const std::string& snapshotPath, const std::string& journalPath, size_t compactAfter = 4096);
+
+	/// <summary>
+	/// Load the snapshot into the grid if it exists, replay the journal over it, and start appending to the journal.
+	/// </summary>
+	/// <param name="grid">Replaced with the snapshot if there is one, then updated by the journal.</param>
+	/// <returns>The number of edits replayed.</returns>
+	size_t Load(Grid& grid);
+
+	/// <summary>
+	/// Append the current value of a cell, after it has been edited.
+	/// </summary>
+	/// <param name="grid">Edited grid. Compacted into a new snapshot if the journal is full. If that fails, compacting is retried only after as many edits again.</param>
+	/// <param name="x">X position of the edited cell.</param>
+	/// <param name="y">Y position of the edited cell.</param>
+	void Record(const Grid& grid, int x, int y);
+
+	/// <summary>
+	/// Replace the snapshot with the grid and empty the journal.
+	/// </summary>
+	/// <param name="grid">Grid to snapshot.</param>
+	/// <returns>True if the snapshot was written, false otherwise. The journal is kept on failure.</returns>
+	bool Compact(const Grid& grid);
+
+	/// <summary>
+	/// Delete the snapshot and the journal, once their edits are persisted somewhere else.
+	/// Record does nothing until the next Load.
+	/// </summary>
+	/// <returns>True if neither file is left, false otherwise.</returns>
+	bool Discard();
+
+	/// <summary>
+	/// Number of edits in the journal since the last snapshot.
+	/// </summary>
+	size_t Size() const;
+
+private:
+	std::string snapshotPath;
+	std::string journalPath;
+	size_t compactAfter;
+	size_t records;
+	// Record compacts once records reaches this. pushed back when compacting fails, so a failing disk is not retried on every edit
+	size_t compactAt;
+	std::ofstream out;
+};
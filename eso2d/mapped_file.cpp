@@ -0,0 +1,156 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() : data(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) { }
+
+bool MappedFile::Open(const std::string& path, size_t size)
+{
+	Close();
+
+	file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, size == 0 ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) { return false; }
+
+	LARGE_INTEGER fileSize;
+	if (size == 0)
+	{
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+		size = static_cast<size_t>(fileSize.QuadPart);
+	}
+	else
+	{
+		fileSize.QuadPart = static_cast<LONGLONG>(size);
+		if (!SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN) || !SetEndOfFile(file))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+	if (!mapping)
+	{
+		Close();
+		return false;
+	}
+
+	data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+
+	this->size = size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+	{
+		UnmapViewOfFile(data);
+		data = nullptr;
+	}
+	if (mapping)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+	size = 0;
+}
+
+bool MappedFile::Flush()
+{
+	return data && FlushViewOfFile(data, size) && FlushFileBuffers(file);
+}
+
+#else
+
+MappedFile::MappedFile() : data(nullptr), size(0), file(-1) { }
+
+bool MappedFile::Open(const std::string& path, size_t size)
+{
+	Close();
+
+	file = open(path.c_str(), size == 0 ? O_RDWR : O_RDWR | O_CREAT, 0644);
+	if (file < 0) { return false; }
+
+	if (size == 0)
+	{
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+		{
+			Close();
+			return false;
+		}
+		size = static_cast<size_t>(info.st_size);
+	}
+	else if (ftruncate(file, static_cast<off_t>(size)) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (mapped == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	data = mapped;
+	this->size = size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data)
+	{
+		munmap(data, size);
+		data = nullptr;
+	}
+	if (file >= 0)
+	{
+		close(file);
+		file = -1;
+	}
+	size = 0;
+}
+
+bool MappedFile::Flush()
+{
+	return data && msync(data, size, MS_SYNC) == 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::IsOpen() const { return data != nullptr; }
+void* MappedFile::Data() const { return data; }
+size_t MappedFile::Size() const { return size; }
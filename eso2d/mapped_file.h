@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/// <summary>
+/// A file mapped read-write into memory and shared with the file on disk.
+/// Writes through Data() reach the file without any explicit save, and survive the process crashing.
+/// </summary>
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// <summary>
+	/// Map a file.
+	/// </summary>
+	/// <param name="path">File to map.</param>
+	/// <param name="size">
+	/// Size to map. If 0, the file must already exist and is mapped at its current size.
+	/// Otherwise the file is created if needed and resized to exactly this size.
+	/// </param>
+	/// <returns>True if the file was mapped, false otherwise.</returns>
+	bool Open(const std::string& path, size_t size = 0);
+	/// <summary>
+	/// Unmap the file. Safe to call if nothing is mapped.
+	/// </summary>
+	void Close();
+
+	bool IsOpen() const;
+	void* Data() const;
+	size_t Size() const;
+
+	/// <summary>
+	/// Write dirty pages back to disk now, rather than when the OS decides to.
+	/// Only needed to survive the whole machine going down.
+	/// </summary>
+	/// <returns>True on success, false otherwise.</returns>
+	bool Flush();
+
+private:
+	void* data;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+};
@@ -0,0 +1,53 @@
+#include "performance.h"
+
+PerformanceMeter::PerformanceMeter(double window) : window(window)
+{
+	Reset();
+}
+
+void PerformanceMeter::Sample(const Grid& grid)
+{
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	const GridCounters& counters = grid.Counters();
+
+	if (!started)
+	{
+		started = true;
+		windowStart = now;
+		windowCounters = counters;
+		frames = 0;
+		return;
+	}
+
+	frames++;
+	const double elapsed = std::chrono::duration<double>(now - windowStart).count();
+	if (elapsed < window) { return; }
+
+	stepsPerSecond = (counters.steps - windowCounters.steps) / elapsed;
+	executionsPerSecond = (counters.executions - windowCounters.executions) / elapsed;
+	frameTime = elapsed / frames;
+	updateShare = (counters.updateNanoseconds - windowCounters.updateNanoseconds) * 1e-9 / elapsed;
+	printShare = (counters.printNanoseconds - windowCounters.printNanoseconds) * 1e-9 / elapsed;
+
+	windowStart = now;
+	windowCounters = counters;
+	frames = 0;
+}
+
+void PerformanceMeter::Reset()
+{
+	started = false;
+	windowCounters = GridCounters();
+	frames = 0;
+	stepsPerSecond = 0;
+	executionsPerSecond = 0;
+	frameTime = 0;
+	updateShare = 0;
+	printShare = 0;
+}
+
+double PerformanceMeter::StepsPerSecond() const { return stepsPerSecond; }
+double PerformanceMeter::ExecutionsPerSecond() const { return executionsPerSecond; }
+double PerformanceMeter::FrameTime() const { return frameTime; }
+double PerformanceMeter::UpdateShare() const { return updateShare; }
+double PerformanceMeter::PrintShare() const { return printShare; }
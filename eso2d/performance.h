@@ -0,0 +1,57 @@
+#pragma once
+
+#include "eso2d.h"
+
+#include <chrono>
+
+/// <summary>
+/// Turns a grid's counters into rates for display, averaged over a short window.
+/// Call Sample once per frame. Enable timing on the grid to get the update and print shares.
+/// </summary>
+class PerformanceMeter
+{
+public:
+	/// <summary>
+	/// Create a meter.
+	/// </summary>
+	/// <param name="window">Seconds to average over before the displayed values change.</param>
+	explicit PerformanceMeter(double window = 0.5);
+
+	/// <summary>
+	/// Record the end of a frame.
+	/// </summary>
+	/// <param name="grid">Grid being run. Must be the same grid every frame, or call Reset first.</param>
+	void Sample(const Grid& grid);
+	/// <summary>
+	/// Forget every sample.
+	/// </summary>
+	void Reset();
+
+	double StepsPerSecond() const;
+	double ExecutionsPerSecond() const;
+	/// <summary>
+	/// Average seconds per frame.
+	/// </summary>
+	double FrameTime() const;
+	/// <summary>
+	/// Fraction of wall time spent in Grid::Update.
+	/// </summary>
+	double UpdateShare() const;
+	/// <summary>
+	/// Fraction of wall time spent in Grid::Print.
+	/// </summary>
+	double PrintShare() const;
+
+private:
+	double window;
+	bool started;
+	std::chrono::steady_clock::time_point windowStart;
+	GridCounters windowCounters;
+	int frames;
+
+	double stepsPerSecond;
+	double executionsPerSecond;
+	double frameTime;
+	double updateShare;
+	double printShare;
+};
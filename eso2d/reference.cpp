@@ -0,0 +1,558 @@
+#include "reference.h"
+
+#include <random>
+
+// everything in this file is a deliberate copy of the interpreter as it was before any optimized engine existed.
+// do not optimize it, and do not route it through Grid helpers that optimized engines may change.
+// the engine below is Cursor::Update, Cursor::Move, TurnLeft, TurnRight, Selection::SetPosition, Selection::MoveBy,
+// Grid::Update, Grid::AddCursors and the View wrapping of the original eso2d.cpp, statement for statement.
+// a change in behaviour belongs here only when the language itself changes, and must be listed below.
+//
+// intentional differences from the original:
+// - members became static functions taking the cursor or selection, with direct access to their fields.
+//   WSelection::Widen and Shrink are inlined, and QueueAddCursor is a push onto cursorsToAdd, as they were.
+// - cells are read and written through Grid::operator()(x, y), so the reference runs on any GridLayout.
+//   the original indexed x + y * width, which is what that operator does for the row-major layout.
+// - steps, executions and writes are not counted, and GridLimits are not checked. the harness steps both engines
+//   the same number of times instead.
+// - Increment and Decrement work digit by digit with a carry or borrow, a language change made in both engines at once.
+//   the original summed the digits into an int, which overflowed for selections ten or more cells wide, and could
+//   divide by zero once the place value wrapped. for narrower selections the results are the same: the number is
+//   taken modulo 10 to the width, zero minus one stays zero, and every digit is written.
+
+static int Wrap(int a, int b)
+{
+	if (a < 0)
+	{
+		return b - (b - a) % b;
+	}
+	else
+	{
+		return a % b;
+	}
+}
+
+enum class Side
+{
+	None,
+	Left,
+	All,
+	Right
+};
+
+bool ReferenceEngine::Update(Grid& grid)
+{
+	for (int i = grid.cursors.size() - 1; i >= 0; i--)
+	{
+		if (!Update(grid.cursors[i], grid))
+		{
+			grid.cursors.erase(grid.cursors.begin() + i);
+		}
+	}
+
+	return grid.cursors.size() > 0;
+}
+
+void ReferenceEngine::AddCursors(Grid& grid)
+{
+	while (!grid.cursorsToAdd.empty())
+	{
+		grid.cursors.push_back(grid.cursorsToAdd.back());
+		grid.cursorsToAdd.pop_back();
+	}
+}
+
+bool ReferenceEngine::Update(Cursor& cursor, Grid& grid)
+{
+	int instruction = Cell(grid, cursor.ip);
+	Side side = Side::None;
+
+	switch (instruction)
+	{
+	case OpCode::IPStart:
+	case OpCode::Path:
+		break;
+
+	case OpCode::Skip:
+		MoveBy(cursor.ip, cursor.dx, cursor.dy, grid);
+		break;
+
+	case OpCode::Left:
+		MoveBy(cursor.selected, -1, 0, grid);
+		break;
+
+	case OpCode::Right:
+		MoveBy(cursor.selected, 1, 0, grid);
+		break;
+
+	case OpCode::Up:
+		MoveBy(cursor.selected, 0, -1, grid);
+		break;
+
+	case OpCode::Down:
+		MoveBy(cursor.selected, 0, 1, grid);
+		break;
+
+	case OpCode::Widen:
+		if (cursor.selected.width < grid.Width()) { cursor.selected.width++; }
+		break;
+
+	case OpCode::Shrink:
+		if (cursor.selected.width > 1) { cursor.selected.width--; }
+		break;
+
+	case OpCode::Move:
+		if (cursor.selected.MovedRight())
+		{
+			// moving right, iterate from right-to-left
+			for (int i = cursor.selected.width - 1; i >= 0; i--)
+			{
+				Cell(grid, cursor.selected, i) = Cell(grid, cursor.selected, i, true);
+			}
+		}
+		else if (cursor.selected.MovedLeft() || cursor.selected.y != cursor.selected.prevY)
+		{
+			// moving left, iterate from left-to-right
+			// moving up or down, iteration order doesn't matter, memory will not overlap
+			for (int i = 0; i < cursor.selected.width; i++)
+			{
+				Cell(grid, cursor.selected, i) = Cell(grid, cursor.selected, i, true);
+			}
+		}
+		break;
+
+	case OpCode::Increment:
+	{
+		bool validOperation = true;
+		for (int i = cursor.selected.width - 1; i >= 0; i--)
+		{
+			// check if grid state is a number
+			int gridValue = Cell(grid, cursor.selected, i);
+			if (gridValue < '0' || gridValue > '9') { validOperation = false; }
+		}
+
+		// do nothing if not a valid number
+		if (!validOperation) { break; }
+
+		// add one with a carry from the rightmost digit. the carry out of the leftmost digit is dropped
+		int carry = 1;
+		for (int i = cursor.selected.width - 1; i >= 0; i--)
+		{
+			int digit = Cell(grid, cursor.selected, i) - '0' + carry;
+			carry = digit / 10;
+			Cell(grid, cursor.selected, i) = '0' + digit % 10;
+		}
+		break;
+	}
+
+	case OpCode::Decrement:
+	{
+		bool validOperation = true;
+		bool zero = true;
+		for (int i = cursor.selected.width - 1; i >= 0; i--)
+		{
+			// check if grid state is a number
+			int gridValue = Cell(grid, cursor.selected, i);
+			if (gridValue < '0' || gridValue > '9') { validOperation = false; }
+			if (gridValue != '0') { zero = false; }
+		}
+
+		// do nothing if not a valid number
+		if (!validOperation) { break; }
+
+		// take one with a borrow from the rightmost digit
+		int borrow = zero ? 0 : 1; // no negative number support in this esolang
+		for (int i = cursor.selected.width - 1; i >= 0; i--)
+		{
+			int digit = Cell(grid, cursor.selected, i) - '0' - borrow;
+			borrow = digit < 0 ? 1 : 0;
+			Cell(grid, cursor.selected, i) = '0' + (digit + 10) % 10;
+		}
+		break;
+	}
+
+	case OpCode::Set:
+		MoveBy(cursor.ip, cursor.dx, cursor.dy, grid);
+		for (int i = 0; i < cursor.selected.width; i++)
+		{
+			Cell(grid, cursor.selected, i) = Cell(grid, cursor.ip);
+		}
+		break;
+
+	case OpCode::Conditional:
+	{
+		bool equal = true;
+		MoveBy(cursor.ip, cursor.dx, cursor.dy, grid);
+		int gridValue = Cell(grid, cursor.ip);
+		switch (gridValue)
+		{
+		case 'N':
+			for (int i = 0; i < cursor.selected.width; i++)
+			{
+				if (Cell(grid, cursor.selected, i) < '0' || Cell(grid, cursor.selected, i) > '9')
+				{
+					equal = false;
+					break;
+				}
+			}
+			break;
+
+		default:
+			for (int i = 0; i < cursor.selected.width; i++)
+			{
+				if (gridValue != Cell(grid, cursor.selected, i))
+				{
+					equal = false;
+					break;
+				}
+			}
+			break;
+		}
+		if (equal)
+		{
+			TurnLeft(cursor);
+		}
+		else
+		{
+			TurnRight(cursor);
+		}
+		break;
+	}
+
+	case OpCode::Split:
+	{
+		Cursor other(cursor);
+		TurnLeft(other);
+		Move(other, grid);
+		TurnRight(cursor);
+		grid.cursorsToAdd.push_back(other);
+		break;
+	}
+
+	case OpCode::LeftIndicator:
+		side = Side::Left;
+		break;
+
+	case OpCode::RightIndicator:
+		side = Side::Right;
+		break;
+
+	default: // OpCode::Terminate is also covered here
+		return false;
+	}
+
+	Move(cursor, grid);
+
+	if (side != Side::None)
+	{
+		instruction = Cell(grid, cursor.ip);
+		int& target = side == Side::Left ? Cell(grid, cursor.selected, 0) : Cell(grid, cursor.selected, cursor.selected.width - 1);
+		switch (instruction)
+		{
+		case OpCode::Conditional:
+			MoveBy(cursor.ip, cursor.dx, cursor.dy, grid);
+			switch (Cell(grid, cursor.ip))
+			{
+			case 'W':
+				if (side == Side::Right)
+				{
+					if (cursor.selected.width == grid.Width())
+					{
+						TurnLeft(cursor);
+					}
+					else
+					{
+						TurnRight(cursor);
+					}
+				}
+				else
+				{
+					if (cursor.selected.width == 1)
+					{
+						TurnLeft(cursor);
+					}
+					else
+					{
+						TurnRight(cursor);
+					}
+				}
+				break;
+
+			case 'N':
+				if (target >= '0' && target <= '9')
+				{
+					TurnLeft(cursor);
+				}
+				else
+				{
+					TurnRight(cursor);
+				}
+				break;
+
+			default:
+				if (Cell(grid, cursor.ip) == target)
+				{
+					TurnLeft(cursor);
+				}
+				else
+				{
+					TurnRight(cursor);
+				}
+				break;
+			}
+			Move(cursor, grid);
+			break;
+
+		case OpCode::Set:
+			MoveBy(cursor.ip, cursor.dx, cursor.dy, grid);
+			target = Cell(grid, cursor.ip);
+			Move(cursor, grid);
+			break;
+
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ReferenceEngine::Move(Cursor& cursor, Grid& grid)
+{
+	MoveBy(cursor.ip, cursor.dx, cursor.dy, grid);
+
+	int count = 0;
+	int oppositeDX = -cursor.dx;
+	int oppositeDY = -cursor.dy;
+	
+	// turn up to 4 times.
+	// turn again if facing opposite direction (avoids turning around rather than left).
+	while ((Cell(grid, cursor.ip) == OpCode::None || (cursor.dx == oppositeDX && cursor.dy == oppositeDY)) && count++ < 4)
+	{
+		MoveBy(cursor.ip, -cursor.dx, -cursor.dy, grid);
+		TurnRight(cursor);
+		MoveBy(cursor.ip, cursor.dx, cursor.dy, grid);
+	}
+}
+
+void ReferenceEngine::TurnLeft(Cursor& cursor)
+{
+	// currently moving on x-axis
+	if (cursor.dx != 0)
+	{
+		cursor.dy = -cursor.dx;
+		cursor.dx = 0;
+	}
+	// currently moving on y-axis
+	else
+	{
+		cursor.dx = cursor.dy;
+		cursor.dy = 0;
+	}
+}
+
+void ReferenceEngine::TurnRight(Cursor& cursor)
+{
+	// currently moving on x-axis
+	if (cursor.dx != 0)
+	{
+		cursor.dy = cursor.dx;
+		cursor.dx = 0;
+	}
+	// currently moving on y-axis
+	else
+	{
+		cursor.dx = -cursor.dy;
+		cursor.dy = 0;
+	}
+}
+
+void ReferenceEngine::SetPosition(Selection& selection, int x, int y, const Grid& grid)
+{
+	selection.wrappedX = selection.wrappedY = false;
+
+	if (x < 0 || x >= grid.Width())
+	{
+		x = Wrap(x, grid.Width());
+		selection.wrappedX = true;
+	}
+
+	if (y < 0 || y >= grid.Height())
+	{
+		y = Wrap(y, grid.Height());
+		selection.wrappedY = true;
+	}
+
+	selection.prevX = selection.x;
+	selection.prevY = selection.y;
+
+	selection.x = x;
+	selection.y = y;
+}
+
+void ReferenceEngine::MoveBy(Selection& selection, int dx, int dy, const Grid& grid)
+{
+	SetPosition(selection, selection.x + dx, selection.y + dy, grid);
+}
+
+int& ReferenceEngine::Cell(Grid& grid, const Selection& selection, bool previous)
+{
+	return grid(previous ? selection.prevX : selection.x, previous ? selection.prevY : selection.y);
+}
+
+int& ReferenceEngine::Cell(Grid& grid, const WSelection& selection, int offset, bool previous)
+{
+	int x = previous ? selection.prevX : selection.x;
+	int y = previous ? selection.prevY : selection.y;
+	return grid((x + offset) % grid.Width(), y);
+}
+
+Grid GenerateProgram(int width, int height, uint32_t seed)
+{
+	static const int instructions[] =
+	{
+		OpCode::Skip, OpCode::Left, OpCode::Right, OpCode::Up, OpCode::Down, OpCode::Widen, OpCode::Shrink,
+		OpCode::Move, OpCode::Increment, OpCode::Decrement, OpCode::Set, OpCode::Conditional, OpCode::Split,
+		OpCode::LeftIndicator, OpCode::RightIndicator, OpCode::Terminate
+	};
+	static const int operands[] = { '0', '1', '5', '9', 'N', 'W', OpCode::Path, OpCode::None };
+	static const int dxs[4] = { 1, 0, -1, 0 };
+	static const int dys[4] = { 0, 1, 0, -1 };
+
+	// rng() % n rather than std::uniform_int_distribution, so a seed gives the same program on every standard library
+	std::mt19937 rng(seed);
+	Grid grid(width, height);
+
+	// numbers for the selection to work on
+	for (int i = width * height / 8; i > 0; i--)
+	{
+		grid(rng() % width, rng() % height) = '0' + rng() % 10;
+	}
+
+	int x = rng() % width;
+	int y = rng() % height;
+	int direction = rng() % 4;
+	grid(x, y) = OpCode::IPStart;
+
+	for (int i = width * height / 2; i > 0; i--)
+	{
+		if (rng() % 4 == 0)
+		{
+			direction = (direction + (rng() % 2 ? 1 : 3)) % 4;
+		}
+		x = Wrap(x + dxs[direction], width);
+		y = Wrap(y + dys[direction], height);
+
+		int& cell = grid(x, y);
+		if (cell == OpCode::IPStart) { continue; }
+
+		if (rng() % 2)
+		{
+			cell = OpCode::Path;
+			continue;
+		}
+
+		cell = instructions[rng() % (sizeof(instructions) / sizeof(instructions[0]))];
+		bool placeOperand = cell == OpCode::Set || cell == OpCode::Conditional;
+		if (cell == OpCode::LeftIndicator || cell == OpCode::RightIndicator)
+		{
+			// mostly follow a side prefix with an instruction that accepts one, then place its operand
+			x = Wrap(x + dxs[direction], width);
+			y = Wrap(y + dys[direction], height);
+			if (grid(x, y) == OpCode::IPStart) { continue; }
+			grid(x, y) = rng() % 4 == 0 ? OpCode::Path : rng() % 2 ? OpCode::Set : OpCode::Conditional;
+			placeOperand = grid(x, y) != OpCode::Path;
+		}
+
+		if (placeOperand)
+		{
+			x = Wrap(x + dxs[direction], width);
+			y = Wrap(y + dys[direction], height);
+			if (grid(x, y) == OpCode::IPStart) { continue; }
+			grid(x, y) = operands[rng() % (sizeof(operands) / sizeof(operands[0]))];
+		}
+	}
+
+	// selection start goes last so nothing overwrites it
+	int selX = rng() % width;
+	int selY = rng() % height;
+	if (grid(selX, selY) != OpCode::IPStart)
+	{
+		grid(selX, selY) = OpCode::SelectionStart;
+	}
+
+	return grid;
+}
+
+static bool Compare(const Grid& expected, const Grid& actual, Divergence& divergence)
+{
+	const std::vector<Cursor>& expectedCursors = expected.Cursors();
+	const std::vector<Cursor>& actualCursors = actual.Cursors();
+
+	if (expectedCursors.size() != actualCursors.size())
+	{
+		divergence.kind = Divergence::CursorCount;
+		divergence.expected = expectedCursors.size();
+		divergence.actual = actualCursors.size();
+		return false;
+	}
+
+	for (size_t i = 0; i < expectedCursors.size(); i++)
+	{
+		if (expectedCursors[i] != actualCursors[i])
+		{
+			divergence.kind = Divergence::CursorState;
+			divergence.cursor = i;
+			return false;
+		}
+	}
+
+	for (int j = 0; j < expected.Height(); j++)
+	{
+		for (int i = 0; i < expected.Width(); i++)
+		{
+			if (expected(i, j) != actual(i, j))
+			{
+				divergence.kind = Divergence::Cell;
+				divergence.x = i;
+				divergence.y = j;
+				divergence.expected = expected(i, j);
+				divergence.actual = actual(i, j);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+Divergence RunDifferential(const Grid& program, bool (*update)(Grid&), uint64_t maxSteps, size_t maxCursors)
+{
+	Grid expected(program);
+	Grid actual(program);
+
+	Divergence divergence = { Divergence::None, 0, -1, -1, -1, 0, 0 };
+	while (divergence.step < maxSteps)
+	{
+		bool expectedAlive = ReferenceEngine::Update(expected);
+		ReferenceEngine::AddCursors(expected);
+		bool actualAlive = update(actual);
+		actual.AddCursors();
+		divergence.step++;
+
+		if (!Compare(expected, actual, divergence)) { return divergence; }
+
+		if (expectedAlive != actualAlive)
+		{
+			divergence.kind = Divergence::Finished;
+			divergence.expected = expectedAlive;
+			divergence.actual = actualAlive;
+			return divergence;
+		}
+
+		// splitting programs grow exponentially, past this point they only cost time
+		if (!expectedAlive || expected.Cursors().size() > maxCursors) { break; }
+	}
+
+	return divergence;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "eso2d.h"
+
+#include <cstdint>
+
+/// <summary>
+/// Frozen copy of the original serial interpreter.
+/// Optimized engines are checked against this, so it must not change with them.
+/// It only touches grid cells through Grid::operator()(x, y) and does its own wrapping.
+/// </summary>
+class ReferenceEngine
+{
+public:
+	/// <summary>
+	/// Step every cursor once, in the original order.
+	/// </summary>
+	/// <param name="grid">Grid to step.</param>
+	/// <returns>True if any cursor is still alive, false otherwise.</returns>
+	static bool Update(Grid& grid);
+	/// <summary>
+	/// Move queued cursors into the grid, in the original order.
+	/// </summary>
+	/// <param name="grid">Grid to add cursors to.</param>
+	static void AddCursors(Grid& grid);
+
+private:
+	static bool Update(Cursor& cursor, Grid& grid);
+	static void Move(Cursor& cursor, Grid& grid);
+	static void TurnLeft(Cursor& cursor);
+	static void TurnRight(Cursor& cursor);
+
+	static void SetPosition(Selection& selection, int x, int y, const Grid& grid);
+	static void MoveBy(Selection& selection, int dx, int dy, const Grid& grid);
+	static int& Cell(Grid& grid, const Selection& selection, bool previous = false);
+	static int& Cell(Grid& grid, const WSelection& selection, int offset, bool previous = false);
+};
+
+/// <summary>
+/// Generate a random program over the OpCode alphabet.
+/// Instructions are laid along a random walk from the IPStart cell, so most programs run for a while.
+/// The same seed always gives the same program.
+/// </summary>
+/// <param name="width">Grid width.</param>
+/// <param name="height">Grid height.</param>
+/// <param name="seed">Random seed.</param>
+/// <returns>The program, with no cursors queued.</returns>
+Grid GenerateProgram(int width, int height, uint32_t seed);
+
+/// <summary>
+/// First difference found between the reference engine and an engine under test.
+/// </summary>
+struct Divergence
+{
+	enum Kind
+	{
+		None, // both engines agreed for every step
+		Finished, // one engine stopped while the other kept running
+		CursorCount, // live cursor counts differ
+		CursorState, // a cursor's ip, selection or direction differs
+		Cell // a grid cell differs
+	};
+
+	Kind kind;
+	// number of steps both engines had taken when the difference was found
+	uint64_t step;
+	// cursor index for CursorState
+	int cursor;
+	// cell position and values for Cell
+	int x;
+	int y;
+	int expected;
+	int actual;
+};
+
+/// <summary>
+/// Step the reference engine and an engine under test side by side, comparing the full state after every step.
+/// </summary>
+/// <param name="program">Starting state, with its cursors already added.</param>
+/// <param name="update">Engine under test. Called once per step, followed by Grid::AddCursors.</param>
+/// <param name="maxSteps">Maximum number of steps to compare.</param>
+/// <param name="maxCursors">Stop comparing, without a divergence, once the reference has more cursors than this.</param>
+/// <returns>The first divergence, or one with kind None.</returns>
+Divergence RunDifferential(const Grid& program, bool (*update)(Grid&), uint64_t maxSteps, size_t maxCursors = 4096);
@@ -0,0 +1,194 @@
+#include "shared_memory.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+static std::string PlatformName(const std::string& name)
+{
+	return "Local\\eso2d-" + name;
+}
+
+SharedMemory::SharedMemory() : data(nullptr), size(0), owner(false), mapping(nullptr) { }
+
+bool SharedMemory::Create(const std::string& name, size_t size)
+{
+	Close();
+
+	const unsigned long long size64 = size;
+	mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xFFFFFFFF), PlatformName(name).c_str());
+	// an existing mapping is another live publisher, which must not be shared
+	if (!mapping || GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		Close();
+		return false;
+	}
+
+	data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!data)
+	{
+		Close();
+		return false;
+	}
+
+	this->size = size;
+	this->name = name;
+	owner = true;
+	return true;
+}
+
+bool SharedMemory::Attach(const std::string& name)
+{
+	Close();
+
+	mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, PlatformName(name).c_str());
+	if (!mapping) { return false; }
+
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	MEMORY_BASIC_INFORMATION info;
+	if (!data || VirtualQuery(data, &info, sizeof(info)) == 0)
+	{
+		Close();
+		return false;
+	}
+
+	size = info.RegionSize;
+	this->name = name;
+	return true;
+}
+
+void SharedMemory::Close()
+{
+	if (data)
+	{
+		UnmapViewOfFile(data);
+		data = nullptr;
+	}
+	// windows removes the name once the last handle closes
+	if (mapping)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+	size = 0;
+	owner = false;
+	name.clear();
+}
+
+#else
+
+static std::string PlatformName(const std::string& name)
+{
+	return "/eso2d-" + name;
+}
+
+SharedMemory::SharedMemory() : data(nullptr), size(0), owner(false), lockFile(-1) { }
+
+bool SharedMemory::Create(const std::string& name, size_t size)
+{
+	Close();
+
+	// a creator holds its block locked until it closes, and the lock goes with it if it crashes.
+	// so a block that can be locked was left by a crashed publisher and is replaced, while one that cannot belongs to a live one
+	const std::string platformName = PlatformName(name);
+	const int existing = shm_open(platformName.c_str(), O_RDWR, 0);
+	if (existing >= 0)
+	{
+		const bool stale = flock(existing, LOCK_EX | LOCK_NB) == 0;
+		close(existing);
+		if (!stale) { return false; }
+		shm_unlink(platformName.c_str());
+	}
+
+	int file = shm_open(platformName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (file < 0) { return false; }
+
+	// the block is new, so the lock can only fail where shared memory cannot be locked at all, and the block is then created unprotected
+	void* mapped = MAP_FAILED;
+	if ((flock(file, LOCK_EX | LOCK_NB) == 0 || errno != EWOULDBLOCK) && ftruncate(file, static_cast<off_t>(size)) == 0)
+	{
+		mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	}
+
+	if (mapped == MAP_FAILED)
+	{
+		close(file);
+		shm_unlink(platformName.c_str());
+		return false;
+	}
+
+	lockFile = file;
+	data = mapped;
+	this->size = size;
+	this->name = name;
+	owner = true;
+	return true;
+}
+
+bool SharedMemory::Attach(const std::string& name)
+{
+	Close();
+
+	int file = shm_open(PlatformName(name).c_str(), O_RDONLY, 0);
+	if (file < 0) { return false; }
+
+	struct stat info;
+	void* mapped = MAP_FAILED;
+	if (fstat(file, &info) == 0 && info.st_size > 0)
+	{
+		mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+	}
+	close(file);
+
+	if (mapped == MAP_FAILED) { return false; }
+
+	data = mapped;
+	size = static_cast<size_t>(info.st_size);
+	this->name = name;
+	return true;
+}
+
+void SharedMemory::Close()
+{
+	if (data)
+	{
+		munmap(data, size);
+		data = nullptr;
+	}
+	if (owner)
+	{
+		shm_unlink(PlatformName(name).c_str());
+	}
+	// closing releases the lock, once the name is already gone
+	if (lockFile >= 0)
+	{
+		close(lockFile);
+		lockFile = -1;
+	}
+	size = 0;
+	owner = false;
+	name.clear();
+}
+
+#endif
+
+SharedMemory::~SharedMemory()
+{
+	Close();
+}
+
+bool SharedMemory::IsOpen() const { return data != nullptr; }
+void* SharedMemory::Data() const { return data; }
+size_t SharedMemory::Size() const { return size; }
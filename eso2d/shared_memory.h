@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/// <summary>
+/// A named block of memory shared between processes, with no file behind it.
+/// Uses POSIX shared memory, or a named file mapping on Windows.
+/// The creator owns the name: it is removed when the creator closes it, while processes already attached keep their view.
+/// </summary>
+class SharedMemory
+{
+public:
+	SharedMemory();
+	~SharedMemory();
+
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory& operator=(const SharedMemory&) = delete;
+
+	/// <summary>
+	/// Create a block read-write, zero-filled.
+	/// A block left under the same name by a crashed process is replaced, but a name in use by a live process cannot be created again.
+	/// On POSIX systems the creator holds a lock on the block to show it is live. Where such locks are unsupported, an existing name is never replaced.
+	/// </summary>
+	/// <param name="name">Name of the block, without any platform prefix.</param>
+	/// <param name="size">Size in bytes.</param>
+	/// <returns>True if the block was created, false otherwise.</returns>
+	bool Create(const std::string& name, size_t size);
+	/// <summary>
+	/// Attach read-only to a block another process created.
+	/// </summary>
+	/// <param name="name">Name of the block, without any platform prefix.</param>
+	/// <returns>True if the block was attached, false otherwise.</returns>
+	bool Attach(const std::string& name);
+	/// <summary>
+	/// Detach, and remove the name if this created the block. Safe to call if nothing is open.
+	/// </summary>
+	void Close();
+
+	bool IsOpen() const;
+	void* Data() const;
+	size_t Size() const;
+
+private:
+	void* data;
+	size_t size;
+	bool owner;
+	std::string name;
+#ifdef _WIN32
+	void* mapping;
+#else
+	// kept open and locked by the creator, so another Create can tell the name is live. -1 if not the creator
+	int lockFile;
+#endif
+};
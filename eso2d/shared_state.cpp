@@ -0,0 +1,261 @@
+#include "shared_state.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <thread>
+
+// layout of the shared memory: this header, then the grid's cells in its own memory order, then maxCursors cursors
+struct SharedStateHeader
+{
+	char magic[4];
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	int32_t layout;
+	uint32_t maxCursors;
+	std::atomic<uint32_t> open;
+	// odd while a publish is in progress. readers retry if it is odd or changes while they copy
+	std::atomic<uint32_t> sequence;
+	uint32_t cursorCount;
+	uint64_t liveCursors;
+	uint64_t steps;
+	uint64_t executions;
+	uint64_t writes;
+	uint64_t publishes;
+};
+
+struct SharedCursor
+{
+	int32_t ipX;
+	int32_t ipY;
+	int32_t selectedX;
+	int32_t selectedY;
+	int32_t selectedWidth;
+	int32_t dx;
+	int32_t dy;
+	int32_t reserved;
+};
+
+static const char sharedStateMagic[4] = { 'E', '2', 'D', 'S' };
+static const uint32_t sharedStateVersion = 2;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared state needs lock-free atomics to work across processes");
+static_assert(sizeof(int) == sizeof(int32_t), "shared cells are copied straight from the grid as 32-bit integers");
+
+static uint64_t SharedStateSize(int width, int height, GridLayout layout, size_t maxCursors)
+{
+	return sizeof(SharedStateHeader) + Grid::Cells(width, height, layout) * sizeof(int32_t) + uint64_t(maxCursors) * sizeof(SharedCursor);
+}
+
+static int32_t* SharedCells(void* data)
+{
+	return reinterpret_cast<int32_t*>(static_cast<char*>(data) + sizeof(SharedStateHeader));
+}
+
+static SharedCursor* SharedCursors(void* data, int width, int height, GridLayout layout)
+{
+	return reinterpret_cast<SharedCursor*>(SharedCells(data) + size_t(Grid::Cells(width, height, layout)));
+}
+
+StatePublisher::StatePublisher(std::chrono::milliseconds interval, size_t maxCursors) :
+	interval(interval), maxCursors(maxCursors), lastPublish(), lastCheck(), stride(1), countdown(1) { }
+
+StatePublisher::~StatePublisher()
+{
+	Close();
+}
+
+bool StatePublisher::Open(const std::string& name, const Grid& grid)
+{
+	Close();
+
+	if (!memory.Create(name, size_t(SharedStateSize(grid.Width(), grid.Height(), grid.layout, maxCursors)))) { return false; }
+
+	SharedStateHeader* header = new (memory.Data()) SharedStateHeader();
+	std::memcpy(header->magic, sharedStateMagic, sizeof(header->magic));
+	header->version = sharedStateVersion;
+	header->width = grid.Width();
+	header->height = grid.Height();
+	header->layout = static_cast<int32_t>(grid.layout);
+	header->maxCursors = static_cast<uint32_t>(maxCursors);
+	header->open.store(1, std::memory_order_release);
+
+	Publish(grid);
+	return true;
+}
+
+void StatePublisher::Close()
+{
+	if (!memory.IsOpen()) { return; }
+
+	static_cast<SharedStateHeader*>(memory.Data())->open.store(0, std::memory_order_release);
+	memory.Close();
+}
+
+bool StatePublisher::IsOpen() const { return memory.IsOpen(); }
+
+bool StatePublisher::Check(const Grid& grid)
+{
+	if (!memory.IsOpen())
+	{
+		// nothing to publish, so stop checking
+		countdown = UINT32_MAX;
+		return false;
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+
+	// aim for one clock read per millisecond, but never wait out more than a tenth of the interval
+	const std::chrono::steady_clock::duration target = std::min<std::chrono::steady_clock::duration>(
+		std::chrono::milliseconds(1), std::chrono::steady_clock::duration(interval) / 10);
+	const auto elapsed = now - lastCheck;
+	if (elapsed < target / 2 && stride < (1u << 20))
+	{
+		stride *= 2;
+	}
+	else if (elapsed > target * 2 && stride > 1)
+	{
+		stride /= 2;
+	}
+	lastCheck = now;
+	countdown = stride;
+
+	if (now - lastPublish < interval) { return false; }
+
+	Publish(grid);
+	return true;
+}
+
+void StatePublisher::Publish(const Grid& grid)
+{
+	if (!memory.IsOpen()) { return; }
+
+	SharedStateHeader* header = static_cast<SharedStateHeader*>(memory.Data());
+	assert(header->width == grid.Width() && header->height == grid.Height() && header->layout == static_cast<int32_t>(grid.layout));
+
+	const uint32_t sequence = header->sequence.load(std::memory_order_relaxed);
+	header->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	// in memory order, as Checkpoint::Capture does. readers put blocked cells back in rows, off the publisher's path
+	std::memcpy(SharedCells(memory.Data()), grid.gridData, grid.Cells() * sizeof(int32_t));
+
+	const std::vector<Cursor>& cursors = grid.Cursors();
+	const size_t count = cursors.size() < maxCursors ? cursors.size() : maxCursors;
+	SharedCursor* shared = SharedCursors(memory.Data(), grid.Width(), grid.Height(), grid.layout);
+	for (size_t i = 0; i < count; i++)
+	{
+		const Cursor& cursor = cursors[i];
+		shared[i] = SharedCursor
+		{
+			cursor.IP().X(), cursor.IP().Y(),
+			cursor.Selected().X(), cursor.Selected().Y(), cursor.Selected().Width(),
+			cursor.DX(), cursor.DY(), 0
+		};
+	}
+
+	header->cursorCount = static_cast<uint32_t>(count);
+	header->liveCursors = cursors.size();
+	header->steps = grid.Counters().steps;
+	header->executions = grid.Counters().executions;
+	header->writes = grid.Counters().writes;
+	header->publishes++;
+
+	header->sequence.store(sequence + 2, std::memory_order_release);
+	lastPublish = std::chrono::steady_clock::now();
+}
+
+StateReader::StateReader() { }
+
+bool StateReader::Attach(const std::string& name)
+{
+	if (!memory.Attach(name)) { return false; }
+
+	const SharedStateHeader* header = static_cast<const SharedStateHeader*>(memory.Data());
+	if (memory.Size() < sizeof(SharedStateHeader) ||
+		std::memcmp(header->magic, sharedStateMagic, sizeof(header->magic)) != 0 || header->version != sharedStateVersion ||
+		header->width <= 0 || header->height <= 0 ||
+		(header->layout != static_cast<int32_t>(GridLayout::RowMajor) && header->layout != static_cast<int32_t>(GridLayout::Blocked)) ||
+		memory.Size() < SharedStateSize(header->width, header->height, static_cast<GridLayout>(header->layout), header->maxCursors))
+	{
+		memory.Close();
+		return false;
+	}
+
+	return true;
+}
+
+void StateReader::Detach()
+{
+	memory.Close();
+}
+
+bool StateReader::IsAttached() const { return memory.IsOpen(); }
+
+bool StateReader::Read(StateSnapshot& snapshot) const
+{
+	if (!memory.IsOpen()) { return false; }
+
+	const SharedStateHeader* header = static_cast<const SharedStateHeader*>(memory.Data());
+	const int width = header->width;
+	const int height = header->height;
+	const GridLayout layout = static_cast<GridLayout>(header->layout);
+	const int32_t* cells = SharedCells(memory.Data());
+	const SharedCursor* shared = SharedCursors(memory.Data(), width, height, layout);
+
+	snapshot.width = width;
+	snapshot.height = height;
+	snapshot.cells.resize(size_t(Grid::Cells(width, height, layout)));
+	snapshot.cursors.reserve(header->maxCursors);
+
+	// publishes are short, so a few retries are enough unless the publisher is publishing constantly
+	for (int attempt = 0; attempt < 100; attempt++)
+	{
+		const uint32_t before = header->sequence.load(std::memory_order_acquire);
+		if (before == 0) { return false; }
+		if (before & 1)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::memcpy(snapshot.cells.data(), cells, snapshot.cells.size() * sizeof(int32_t));
+
+		uint32_t count = header->cursorCount;
+		if (count > header->maxCursors) { count = header->maxCursors; }
+		snapshot.cursors.clear();
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const SharedCursor cursor = shared[i];
+			snapshot.cursors.emplace_back(cursor.ipX, cursor.ipY, cursor.selectedX, cursor.selectedY, cursor.selectedWidth, cursor.dx, cursor.dy);
+		}
+
+		snapshot.liveCursors = header->liveCursors;
+		snapshot.counters = GridCounters { header->steps, header->executions, header->writes, 0, 0 };
+		snapshot.publishes = header->publishes;
+		snapshot.open = header->open.load(std::memory_order_acquire) != 0;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (header->sequence.load(std::memory_order_relaxed) != before) { continue; }
+
+		if (layout == GridLayout::Blocked)
+		{
+			Grid grid(width, height, layout);
+			std::copy(snapshot.cells.begin(), snapshot.cells.end(), grid.gridData);
+			snapshot.cells.resize(size_t(width) * size_t(height));
+			for (int j = 0; j < height; j++)
+			{
+				for (int i = 0; i < width; i++)
+				{
+					snapshot.cells[i + size_t(j) * width] = grid(i, j);
+				}
+			}
+		}
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "eso2d.h"
+#include "shared_memory.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Copy of a grid's state read from shared memory.
+/// </summary>
+struct StateSnapshot
+{
+	int width;
+	int height;
+	// width * height cells, row-major
+	std::vector<int> cells;
+	// at most the publisher's cursor limit. ip and selection positions, widths and directions only
+	std::vector<Cursor> cursors;
+	// cursors alive when published, which may be more than were copied
+	uint64_t liveCursors;
+	GridCounters counters;
+	// number of times the state has been published
+	uint64_t publishes;
+	// false once the publisher has closed
+	bool open;
+};
+
+/// <summary>
+/// Publishes a running grid into named shared memory, so other processes can watch it without touching the run.
+/// Publishing is a copy of the cells and cursors under a sequence lock: readers never block the publisher, they retry instead.
+/// Between publishes, most calls to Update only decrement a counter. The clock is read about once a millisecond, however long steps take.
+/// </summary>
+class StatePublisher
+{
+public:
+	/// <summary>
+	/// Create a publisher. Nothing is shared until Open.
+	/// </summary>
+	/// <param name="interval">Minimum time between publishes.</param>
+	/// <param name="maxCursors">Most cursors copied per publish. Any more are counted but not copied.</param>
+	explicit StatePublisher(std::chrono::milliseconds interval = std::chrono::milliseconds(100), size_t maxCursors = 4096);
+	~StatePublisher();
+
+	/// <summary>
+	/// Create the shared memory for a grid of this size.
+	/// </summary>
+	/// <param name="name">Name readers attach with.</param>
+	/// <param name="grid">Grid that will be published. Its size must not change while open.</param>
+	/// <returns>True if the shared memory was created, false otherwise.</returns>
+	bool Open(const std::string& name, const Grid& grid);
+	/// <summary>
+	/// Mark the state closed for readers, and remove the name.
+	/// </summary>
+	void Close();
+	bool IsOpen() const;
+
+	/// <summary>
+	/// Publish the grid if the interval has passed since the last publish. Call once per step.
+	/// </summary>
+	/// <param name="grid">Grid given to Open.</param>
+	/// <returns>True if the grid was published.</returns>
+	bool Update(const Grid& grid)
+	{
+		if (--countdown > 0) { return false; }
+		return Check(grid);
+	}
+	/// <summary>
+	/// Publish the grid now.
+	/// </summary>
+	/// <param name="grid">Grid given to Open.</param>
+	void Publish(const Grid& grid);
+
+private:
+	// read the clock, publish if due, and pick how many calls to skip before reading it again
+	bool Check(const Grid& grid);
+
+	SharedMemory memory;
+	std::chrono::milliseconds interval;
+	size_t maxCursors;
+	std::chrono::steady_clock::time_point lastPublish;
+	std::chrono::steady_clock::time_point lastCheck;
+	uint32_t stride;
+	uint32_t countdown;
+};
+
+/// <summary>
+/// Attaches read-only to state shared by a StatePublisher in another process.
+/// </summary>
+class StateReader
+{
+public:
+	StateReader();
+
+	/// <summary>
+	/// Attach to a publisher.
+	/// </summary>
+	/// <param name="name">Name given to StatePublisher::Open.</param>
+	/// <returns>True if attached, false if there is no publisher under this name.</returns>
+	bool Attach(const std::string& name);
+	void Detach();
+	bool IsAttached() const;
+
+	/// <summary>
+	/// Copy a consistent snapshot of the latest published state.
+	/// </summary>
+	/// <param name="snapshot">Filled with the state on success.</param>
+	/// <returns>True on success, false if nothing has been published yet or the publisher kept writing for every retry.</returns>
+	bool Read(StateSnapshot& snapshot) const;
+
+private:
+	SharedMemory memory;
+};
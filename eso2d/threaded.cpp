@@ -0,0 +1,295 @@
+#include "threaded.h"
+
+#include <chrono>
+
+ThreadedStepper::ThreadedStepper() { }
+
+ThreadedStepper::Handler ThreadedStepper::Decode(int instruction)
+{
+	// handler for each instruction below 128. everything else is not an instruction, so its cursor dies.
+	struct Table
+	{
+		uint8_t handlers[128];
+	};
+
+	static const Table table = []
+	{
+		Table table;
+		for (uint8_t& handler : table.handlers) { handler = DeathHandler; }
+
+		table.handlers[OpCode::Path] = PathHandler;
+		table.handlers[OpCode::IPStart] = PathHandler;
+		table.handlers[OpCode::Skip] = SkipHandler;
+		table.handlers[OpCode::Left] = LeftHandler;
+		table.handlers[OpCode::Right] = RightHandler;
+		table.handlers[OpCode::Up] = UpHandler;
+		table.handlers[OpCode::Down] = DownHandler;
+		table.handlers[OpCode::Widen] = WidenHandler;
+		table.handlers[OpCode::Shrink] = ShrinkHandler;
+		table.handlers[OpCode::Move] = MoveHandler;
+		table.handlers[OpCode::Increment] = IncrementHandler;
+		table.handlers[OpCode::Decrement] = DecrementHandler;
+		table.handlers[OpCode::Set] = SetHandler;
+		table.handlers[OpCode::Conditional] = ConditionalHandler;
+		table.handlers[OpCode::Split] = SplitHandler;
+		table.handlers[OpCode::LeftIndicator] = LeftPrefixHandler;
+		table.handlers[OpCode::RightIndicator] = RightPrefixHandler;
+		return table;
+	}();
+
+	return static_cast<unsigned int>(instruction) < 128 ? static_cast<Handler>(table.handlers[instruction]) : DeathHandler;
+}
+
+ThreadedStepper::Handler ThreadedStepper::DecodeSide(int instruction, bool left)
+{
+	switch (instruction)
+	{
+	case OpCode::Conditional:
+		return left ? LeftConditionalHandler : RightConditionalHandler;
+
+	case OpCode::Set:
+		return left ? LeftSetHandler : RightSetHandler;
+
+	default:
+		return DeathHandler;
+	}
+}
+
+inline void ThreadedStepper::Advance(Cursor& cursor, Grid& grid)
+{
+	Selection& ip = cursor.ip;
+	int x = ip.x + cursor.dx;
+	int y = ip.y + cursor.dy;
+	const bool wrappedX = x < 0 || x >= grid.width;
+	const bool wrappedY = y < 0 || y >= grid.height;
+	if (wrappedX) { x = grid.WrapX(x); }
+	if (wrappedY) { y = grid.WrapY(y); }
+
+	// an empty cell means turning, which the full version handles
+	if (grid.gridData[grid.Index(x, y)] == OpCode::None)
+	{
+		cursor.Move(grid);
+		return;
+	}
+
+	ip.prevX = ip.x;
+	ip.prevY = ip.y;
+	ip.x = x;
+	ip.y = y;
+	ip.wrappedX = wrappedX;
+	ip.wrappedY = wrappedY;
+}
+
+inline int ThreadedStepper::Instruction(const Cursor& cursor, const Grid& grid)
+{
+	return grid.gridData[grid.Index(cursor.ip.x, cursor.ip.y)];
+}
+
+#if ESO2D_COMPUTED_GOTO
+#define HANDLER(name) name##Label:
+#define DISPATCH(handler) goto *labels[handler]
+#else
+#define HANDLER(name) case name:
+#define DISPATCH(handler) do { next = (handler); goto Dispatch; } while (false)
+#endif
+
+// move on to the next cursor in Grid::Update's order, and run its instruction
+#define NEXT() \
+	do \
+	{ \
+		if (--i < 0) { goto Done; } \
+		cursor = &cursors[i]; \
+		DISPATCH(Decode(Instruction(*cursor, grid))); \
+	} while (false)
+
+bool ThreadedStepper::Update(Grid& grid)
+{
+	if (!grid.BeginStep()) { return false; }
+
+	const bool timed = grid.timing;
+	std::chrono::steady_clock::time_point start;
+	if (timed) { start = std::chrono::steady_clock::now(); }
+
+	std::vector<Cursor>& cursors = grid.cursors;
+	grid.counters.executions += cursors.size();
+
+	dead.assign(cursors.size(), 0);
+	bool anyDead = false;
+
+	NullHooks hooks;
+	Cursor* cursor = nullptr;
+	int i = cursors.size();
+
+#if ESO2D_COMPUTED_GOTO
+	// same order as Handler
+	static void* const labels[HandlerCount] =
+	{
+		&&PathHandlerLabel,
+		&&SkipHandlerLabel,
+		&&LeftHandlerLabel,
+		&&RightHandlerLabel,
+		&&UpHandlerLabel,
+		&&DownHandlerLabel,
+		&&WidenHandlerLabel,
+		&&ShrinkHandlerLabel,
+		&&MoveHandlerLabel,
+		&&IncrementHandlerLabel,
+		&&DecrementHandlerLabel,
+		&&SetHandlerLabel,
+		&&ConditionalHandlerLabel,
+		&&SplitHandlerLabel,
+		&&LeftPrefixHandlerLabel,
+		&&RightPrefixHandlerLabel,
+		&&LeftConditionalHandlerLabel,
+		&&RightConditionalHandlerLabel,
+		&&LeftSetHandlerLabel,
+		&&RightSetHandlerLabel,
+		&&DeathHandlerLabel
+	};
+#else
+	Handler next = DeathHandler;
+#endif
+
+	NEXT();
+
+#if !ESO2D_COMPUTED_GOTO
+Dispatch:
+	switch (next)
+	{
+#endif
+	HANDLER(PathHandler)
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(SkipHandler)
+		cursor->ip.MoveBy(cursor->dx, cursor->dy, grid);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(LeftHandler)
+		cursor->selected.MoveBy(-1, 0, grid);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(RightHandler)
+		cursor->selected.MoveBy(1, 0, grid);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(UpHandler)
+		cursor->selected.MoveBy(0, -1, grid);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(DownHandler)
+		cursor->selected.MoveBy(0, 1, grid);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(WidenHandler)
+		cursor->selected.Widen(grid);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(ShrinkHandler)
+		cursor->selected.Shrink(grid);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(MoveHandler)
+		cursor->MoveCells(grid, hooks);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(IncrementHandler)
+		cursor->Add(grid, hooks, 1);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(DecrementHandler)
+		cursor->Add(grid, hooks, -1);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(SetHandler)
+		cursor->SetAll(grid, hooks);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(ConditionalHandler)
+		cursor->Conditional(grid);
+		Advance(*cursor, grid);
+		NEXT();
+
+	HANDLER(SplitHandler)
+	{
+		Cursor other(*cursor);
+		other.TurnLeft();
+		other.Move(grid);
+		cursor->TurnRight();
+		Advance(*cursor, grid);
+		// queued cursors live in a separate vector, so cursor stays valid
+		grid.QueueAddCursor(other);
+		NEXT();
+	}
+
+	HANDLER(LeftPrefixHandler)
+		Advance(*cursor, grid);
+		DISPATCH(DecodeSide(Instruction(*cursor, grid), true));
+
+	HANDLER(RightPrefixHandler)
+		Advance(*cursor, grid);
+		DISPATCH(DecodeSide(Instruction(*cursor, grid), false));
+
+	HANDLER(LeftConditionalHandler)
+		cursor->SideConditional(grid, Cursor::Side::Left);
+		NEXT();
+
+	HANDLER(RightConditionalHandler)
+		cursor->SideConditional(grid, Cursor::Side::Right);
+		NEXT();
+
+	HANDLER(LeftSetHandler)
+		cursor->SetSide(grid, hooks, Cursor::Side::Left);
+		NEXT();
+
+	HANDLER(RightSetHandler)
+		cursor->SetSide(grid, hooks, Cursor::Side::Right);
+		NEXT();
+
+	HANDLER(DeathHandler)
+		dead[i] = 1;
+		anyDead = true;
+		NEXT();
+#if !ESO2D_COMPUTED_GOTO
+	default:
+		NEXT();
+	}
+#endif
+
+Done:
+	// remove dead cursors in one pass, keeping the rest in the order erase would have left them
+	if (anyDead)
+	{
+		size_t kept = 0;
+		for (size_t j = 0; j < cursors.size(); j++)
+		{
+			if (dead[j]) { continue; }
+			if (kept != j) { cursors[kept] = cursors[j]; }
+			kept++;
+		}
+		cursors.erase(cursors.begin() + kept, cursors.end());
+	}
+	const bool withinLimits = grid.EndStep();
+
+	if (timed)
+	{
+		grid.counters.updateNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	return withinLimits && cursors.size() > 0;
+}
+
+#undef NEXT
+#undef DISPATCH
+#undef HANDLER
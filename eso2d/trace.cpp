@@ -0,0 +1,418 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <climits>
+
+// file layout:
+//   magic "E2DT", version, width, height, then width * height initial cells in row-major order
+//   followed by records, each a Trace::Tag byte and its fields.
+// all integers are LEB128 varints, signed ones zigzag encoded.
+// cursor positions are stored relative to the previous execute record, write positions relative to the previous write.
+
+static const char magic[4] = { 'E', '2', 'D', 'T' };
+static const uint64_t version = 1;
+
+// buffers are handed to the writer thread once they reach this size
+static const size_t flushSize = 1 << 16;
+// the interpreter blocks once this many buffers are waiting to be written
+static const size_t maxQueued = 64;
+
+static int DirectionCode(int dx, int dy)
+{
+	if (dx > 0) { return 0; }
+	if (dy > 0) { return 1; }
+	if (dx < 0) { return 2; }
+	return 3;
+}
+
+static void DirectionFromCode(int code, int& dx, int& dy)
+{
+	static const int dxs[4] = { 1, 0, -1, 0 };
+	static const int dys[4] = { 0, 1, 0, -1 };
+	dx = dxs[code & 3];
+	dy = dys[code & 3];
+}
+
+TraceWriter::TraceWriter(const std::string& path) : out(path, std::ios_base::binary | std::ios_base::trunc), writing(false), stopping(false)
+{
+	if (out)
+	{
+		thread = std::thread(&TraceWriter::Run, this);
+	}
+}
+
+TraceWriter::~TraceWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	ready.notify_one();
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+bool TraceWriter::IsOpen() const { return out.is_open(); }
+
+void TraceWriter::Submit(std::vector<char>& buffer)
+{
+	if (!thread.joinable())
+	{
+		buffer.clear();
+		return;
+	}
+	if (buffer.empty()) { return; }
+
+	std::unique_lock<std::mutex> lock(mutex);
+	drained.wait(lock, [this] { return queue.size() < maxQueued; });
+
+	queue.push_back(std::vector<char>());
+	queue.back().swap(buffer);
+
+	if (!spare.empty())
+	{
+		buffer.swap(spare.back());
+		spare.pop_back();
+	}
+	lock.unlock();
+
+	ready.notify_one();
+}
+
+void TraceWriter::Flush()
+{
+	if (!thread.joinable()) { return; }
+
+	std::unique_lock<std::mutex> lock(mutex);
+	drained.wait(lock, [this] { return queue.empty() && !writing; });
+}
+
+void TraceWriter::Run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		ready.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (queue.empty())
+		{
+			// only reached when stopping with nothing left to write
+			break;
+		}
+
+		std::vector<char> buffer;
+		buffer.swap(queue.front());
+		queue.pop_front();
+		writing = true;
+		lock.unlock();
+
+		// flush every buffer so a crashed run still leaves a readable trace
+		out.write(buffer.data(), buffer.size());
+		out.flush();
+
+		lock.lock();
+		writing = false;
+		buffer.clear();
+		spare.push_back(std::move(buffer));
+		drained.notify_all();
+	}
+}
+
+TraceRecorder::TraceRecorder(const std::string& path, const Grid& initial) :
+	writer(path),
+	lastIpX(0), lastIpY(0), lastSelX(0), lastSelY(0), lastWriteX(0), lastWriteY(0)
+{
+	buffer.reserve(flushSize * 2);
+
+	buffer.insert(buffer.end(), magic, magic + sizeof(magic));
+	PutUnsigned(version);
+	PutUnsigned(initial.Width());
+	PutUnsigned(initial.Height());
+	for (int j = 0; j < initial.Height(); j++)
+	{
+		for (int i = 0; i < initial.Width(); i++)
+		{
+			PutSigned(initial(i, j));
+		}
+	}
+	Submit();
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	Flush();
+}
+
+bool TraceRecorder::IsOpen() const { return writer.IsOpen(); }
+
+void TraceRecorder::Flush()
+{
+	writer.Submit(buffer);
+	writer.Flush();
+}
+
+void TraceRecorder::OnStep(const Grid&)
+{
+	PutByte(Trace::Step);
+	if (buffer.size() >= flushSize) { Submit(); }
+}
+
+void TraceRecorder::OnExecute(const Grid&, const Cursor& cursor, int instruction)
+{
+	const Selection& ip = cursor.IP();
+	const WSelection& selected = cursor.Selected();
+
+	PutByte(Trace::Execute);
+	PutSigned(instruction);
+	PutSigned(ip.X() - lastIpX);
+	PutSigned(ip.Y() - lastIpY);
+	PutByte(DirectionCode(cursor.DX(), cursor.DY()));
+	PutSigned(selected.X() - lastSelX);
+	PutSigned(selected.Y() - lastSelY);
+	PutUnsigned(selected.Width());
+
+	lastIpX = ip.X();
+	lastIpY = ip.Y();
+	lastSelX = selected.X();
+	lastSelY = selected.Y();
+}
+
+void TraceRecorder::OnWrite(const Grid&, int x, int y, int, int newValue)
+{
+	PutByte(Trace::Write);
+	PutSigned(x - lastWriteX);
+	PutSigned(y - lastWriteY);
+	PutSigned(newValue);
+
+	lastWriteX = x;
+	lastWriteY = y;
+}
+
+void TraceRecorder::PutByte(uint8_t value)
+{
+	buffer.push_back(static_cast<char>(value));
+}
+
+void TraceRecorder::PutUnsigned(uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back(static_cast<char>(value));
+}
+
+void TraceRecorder::PutSigned(int64_t value)
+{
+	PutUnsigned((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void TraceRecorder::Submit()
+{
+	writer.Submit(buffer);
+}
+
+TraceReader::TraceReader(const std::string& path) :
+	in(path, std::ios_base::binary),
+	width(0), height(0),
+	step(0), lastIpX(0), lastIpY(0), lastSelX(0), lastSelY(0), lastWriteX(0), lastWriteY(0)
+{
+	char header[sizeof(magic)];
+	uint64_t fileVersion, w, h;
+	if (!in.read(header, sizeof(header)) || !std::equal(header, header + sizeof(header), magic) ||
+		!GetUnsigned(fileVersion) || fileVersion != version ||
+		!GetUnsigned(w) || !GetUnsigned(h) || w == 0 || h == 0 || w > INT_MAX || h > INT_MAX || w * h > INT_MAX)
+	{
+		in.close();
+		return;
+	}
+
+	// every initial cell takes at least a byte, so a header claiming more cells than the file holds is not believed
+	const std::streampos cellsStart = in.tellg();
+	in.seekg(0, std::ios_base::end);
+	const std::streamoff remaining = in.tellg() - cellsStart;
+	in.seekg(cellsStart);
+	if (cellsStart < 0 || remaining < 0 || w * h > static_cast<uint64_t>(remaining))
+	{
+		in.close();
+		return;
+	}
+
+	width = static_cast<int>(w);
+	height = static_cast<int>(h);
+	initial.resize(size_t(w * h));
+	for (int& cell : initial)
+	{
+		int64_t value;
+		if (!GetSigned(value))
+		{
+			in.close();
+			return;
+		}
+		cell = static_cast<int>(value);
+	}
+
+	recordsStart = in.tellg();
+}
+
+bool TraceReader::IsOpen() const { return in.is_open(); }
+
+int TraceReader::Width() const { return width; }
+int TraceReader::Height() const { return height; }
+
+bool TraceReader::Next(TraceEvent& event)
+{
+	if (!in.is_open()) { return false; }
+
+	int tag = in.rdbuf()->sbumpc();
+	if (tag == std::char_traits<char>::eof()) { return false; }
+
+	event.tag = static_cast<Trace::Tag>(tag);
+	switch (tag)
+	{
+	case Trace::Step:
+		event.step = step++;
+		return true;
+
+	case Trace::Execute:
+	{
+		int64_t instruction, ipX, ipY, selX, selY;
+		uint64_t selWidth;
+		int direction;
+		if (!GetSigned(instruction) || !GetSigned(ipX) || !GetSigned(ipY)) { return false; }
+		if ((direction = in.rdbuf()->sbumpc()) == std::char_traits<char>::eof()) { return false; }
+		if (!GetSigned(selX) || !GetSigned(selY) || !GetUnsigned(selWidth)) { return false; }
+
+		lastIpX += static_cast<int>(ipX);
+		lastIpY += static_cast<int>(ipY);
+		lastSelX += static_cast<int>(selX);
+		lastSelY += static_cast<int>(selY);
+
+		event.step = step - 1;
+		event.instruction = static_cast<int>(instruction);
+		event.ipX = lastIpX;
+		event.ipY = lastIpY;
+		DirectionFromCode(direction, event.dx, event.dy);
+		event.selX = lastSelX;
+		event.selY = lastSelY;
+		event.selWidth = static_cast<int>(selWidth);
+		return true;
+	}
+
+	case Trace::Write:
+	{
+		int64_t x, y, value;
+		if (!GetSigned(x) || !GetSigned(y) || !GetSigned(value)) { return false; }
+
+		lastWriteX += static_cast<int>(x);
+		lastWriteY += static_cast<int>(y);
+
+		event.step = step - 1;
+		event.x = lastWriteX;
+		event.y = lastWriteY;
+		event.value = static_cast<int>(value);
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+void TraceReader::Rewind()
+{
+	if (!in.is_open()) { return; }
+
+	in.clear();
+	in.seekg(recordsStart);
+	step = 0;
+	lastIpX = lastIpY = lastSelX = lastSelY = lastWriteX = lastWriteY = 0;
+}
+
+uint64_t TraceReader::Replay(uint64_t targetStep, Grid& grid)
+{
+	Grid rebuilt(width, height);
+	for (int j = 0; j < height; j++)
+	{
+		for (int i = 0; i < width; i++)
+		{
+			rebuilt(i, j) = initial[i + j * width];
+		}
+	}
+
+	Rewind();
+
+	// a step's writes are held back until the step is known to be complete, at the next step marker or a clean end of file.
+	// a step cut short by a torn or malformed record is left out, so the grid always matches the count returned
+	uint64_t applied = 0;
+	bool inStep = false;
+	std::vector<TraceEvent> writes;
+	auto apply = [&rebuilt, &writes]
+	{
+		for (const TraceEvent& write : writes)
+		{
+			rebuilt(write.x, write.y) = write.value;
+		}
+		writes.clear();
+	};
+
+	TraceEvent event;
+	for (;;)
+	{
+		const bool end = in.rdbuf()->sgetc() == std::char_traits<char>::eof();
+		if (end || !Next(event))
+		{
+			if (end && inStep)
+			{
+				apply();
+				applied++;
+			}
+			break;
+		}
+
+		if (event.tag == Trace::Step)
+		{
+			if (inStep)
+			{
+				apply();
+				applied = event.step;
+			}
+			if (event.step == targetStep) { break; }
+			inStep = true;
+			writes.clear();
+		}
+		else if (event.tag == Trace::Write)
+		{
+			if (event.x < 0 || event.y < 0 || event.x >= width || event.y >= height) { break; }
+			writes.push_back(event);
+		}
+	}
+
+	grid = std::move(rebuilt);
+	return applied;
+}
+
+bool TraceReader::GetUnsigned(uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int byte = in.rdbuf()->sbumpc();
+		if (byte == std::char_traits<char>::eof()) { return false; }
+
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) { return true; }
+	}
+	return false;
+}
+
+bool TraceReader::GetSigned(int64_t& value)
+{
+	uint64_t raw;
+	if (!GetUnsigned(raw)) { return false; }
+
+	value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+	return true;
+}
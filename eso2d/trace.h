@@ -0,0 +1,179 @@
+#pragma once
+
+#include "eso2d.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Trace
+{
+	enum Tag : uint8_t
+	{
+		Step = 1, // a grid step begins
+		Execute = 2, // a cursor executes an instruction
+		Write = 3 // a cell is written
+	};
+}
+
+/// <summary>
+/// One decoded trace record.
+/// Execute records fill the cursor fields, write records fill x, y and value.
+/// </summary>
+struct TraceEvent
+{
+	Trace::Tag tag;
+	uint64_t step;
+
+	int instruction;
+	int ipX;
+	int ipY;
+	int dx;
+	int dy;
+	int selX;
+	int selY;
+	int selWidth;
+
+	int x;
+	int y;
+	int value;
+};
+
+/// <summary>
+/// Appends buffers to a file from a background thread, so the interpreter never waits on disk.
+/// </summary>
+class TraceWriter
+{
+public:
+	explicit TraceWriter(const std::string& path);
+	~TraceWriter();
+
+	TraceWriter(const TraceWriter&) = delete;
+	TraceWriter& operator=(const TraceWriter&) = delete;
+
+	bool IsOpen() const;
+
+	/// <summary>
+	/// Hand a buffer to the writer thread. Blocks only if the writer has fallen far behind.
+	/// </summary>
+	/// <param name="buffer">Bytes to append. Left empty on return.</param>
+	void Submit(std::vector<char>& buffer);
+	/// <summary>
+	/// Wait until every submitted buffer has reached the file.
+	/// </summary>
+	void Flush();
+
+private:
+	void Run();
+
+	std::ofstream out;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::condition_variable drained;
+	std::deque<std::vector<char>> queue;
+	std::vector<std::vector<char>> spare;
+	bool writing;
+	bool stopping;
+	std::thread thread;
+};
+
+/// <summary>
+/// Hook policy that records a compact, delta-encoded execution trace.
+/// Pass it to Grid::Update to record that step.
+/// </summary>
+class TraceRecorder
+{
+public:
+	/// <summary>
+	/// Start a trace file.
+	/// </summary>
+	/// <param name="path">File to write to. Overwritten if it exists.</param>
+	/// <param name="initial">Grid state before the first traced step.</param>
+	TraceRecorder(const std::string& path, const Grid& initial);
+	~TraceRecorder();
+
+	bool IsOpen() const;
+
+	/// <summary>
+	/// Wait until everything recorded so far is on disk.
+	/// </summary>
+	void Flush();
+
+	void OnStep(const Grid&);
+	void OnExecute(const Grid&, const Cursor& cursor, int instruction);
+	void OnWrite(const Grid&, int x, int y, int oldValue, int newValue);
+	void OnSpawn(const Grid&, const Cursor&, const Cursor&) { }
+	void OnDeath(const Grid&, const Cursor&) { }
+
+private:
+	void PutByte(uint8_t value);
+	void PutUnsigned(uint64_t value);
+	void PutSigned(int64_t value);
+	void Submit();
+
+	TraceWriter writer;
+	std::vector<char> buffer;
+
+	int lastIpX;
+	int lastIpY;
+	int lastSelX;
+	int lastSelY;
+	int lastWriteX;
+	int lastWriteY;
+};
+
+/// <summary>
+/// Reads a trace written by TraceRecorder, and rebuilds grid state from it.
+/// </summary>
+class TraceReader
+{
+public:
+	explicit TraceReader(const std::string& path);
+
+	bool IsOpen() const;
+
+	int Width() const;
+	int Height() const;
+
+	/// <summary>
+	/// Decode the next record.
+	/// </summary>
+	/// <param name="event">Filled with the record.</param>
+	/// <returns>True if a record was read, false at the end of the trace or on a malformed record.</returns>
+	bool Next(TraceEvent& event);
+	/// <summary>
+	/// Go back to the first record.
+	/// </summary>
+	void Rewind();
+
+	/// <summary>
+	/// Rebuild the grid cells as they were after the given number of steps.
+	/// </summary>
+	/// <param name="step">Number of steps to apply. Stops early if the trace is shorter, leaving out a last step cut short by a torn record.</param>
+	/// <param name="grid">Replaced with the rebuilt grid. Has no cursors.</param>
+	/// <returns>The number of steps actually applied.</returns>
+	uint64_t Replay(uint64_t step, Grid& grid);
+
+private:
+	bool GetUnsigned(uint64_t& value);
+	bool GetSigned(int64_t& value);
+
+	std::ifstream in;
+	std::streampos recordsStart;
+	int width;
+	int height;
+	std::vector<int> initial;
+
+	uint64_t step;
+	int lastIpX;
+	int lastIpY;
+	int lastSelX;
+	int lastSelY;
+	int lastWriteX;
+	int lastWriteY;
+};